@@ -10,9 +10,11 @@ vec4 mul_quatern(vec4 u, vec4 v){
             v.y * u.z - v.z * u.y + v.w * u.x + v.x * u.w);
 }
 
-uniform vec4 q, q_inv;
-uniform vec2 viewport_size;
-uniform float zoom_level;
+layout(std140, binding = 0) uniform Camera {
+    vec4 q, q_inv;
+    vec2 viewport_size;
+    float zoom_level;
+};
 layout(location = 0) in vec3 in_pos;        // Vertex position
 layout(location = 1) in vec3 in_color;        // Vertex normal
 out vec3 position;// flat shading
@@ -10,23 +10,52 @@ vec4 mul_quatern(vec4 u, vec4 v){
             v.y * u.z - v.z * u.y + v.w * u.x + v.x * u.w);
 }
 
-uniform vec4 q, q_inv;
-uniform float zoom_level;
-uniform vec2 viewport_size;
+layout(std140, binding = 0) uniform Camera {
+    vec4 q, q_inv;
+    vec2 viewport_size;
+    float zoom_level;
+};
+
+struct ObjectData {
+    // object transform and decoding of the packed positions
+    vec3 scale;
+    float width; // curves width
+    vec3 translation;
+    vec4 tint;
+    // scalar to colormap coordinate scale and offset, and colormap layer,
+    // negative for the vertex colors
+    vec4 colormap;
+};
+layout(std430, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+uniform int first_object; // index of the first command of the draw call
+
 layout(location = 0) in vec3 in_pos;        // Vertex position
 layout(location = 1) in vec3 in_color;        // Vertex colors
+layout(location = 2) in float in_scalar;      // Colormapped value
+layout(binding = 0) uniform sampler1DArray colormaps;
 out vec3 position;// flat shading
 out vec3 color;
 void main()
 {
+    ObjectData object = objects[first_object + gl_DrawID];
+    vec3 world_pos = in_pos * object.scale + object.translation;
     // rotation
-    vec4 pos = mul_quatern(vec4(0.0, in_pos.xyz), q_inv);
+    vec4 pos = mul_quatern(vec4(0.0, world_pos), q_inv);
     pos = mul_quatern(q, pos);
     position = pos.yzw;// for flat shading
     pos.yz *= -2/(pos.w - 2); // perspective
     pos.yz = pos.yz * zoom_level;
     pos.y *= viewport_size.y/viewport_size.x; //aspect ratio
     gl_Position = vec4(pos.yzw, 1.0);
-    color = in_color;
+    vec3 vertex_color = in_color;
+    if (object.colormap.z >= 0) {
+        vec2 texture_coord = vec2(
+                in_scalar * object.colormap.x + object.colormap.y,
+                object.colormap.z);
+        vertex_color = texture(colormaps, texture_coord).rgb;
+    }
+    color = vertex_color * object.tint.rgb;
 
 }
@@ -7,9 +7,14 @@ out vec3 normal;
 out vec3 position;
 out vec3 color;
 
-uniform float r;
-uniform float zoom_level;
-uniform vec2 viewport_size;
+in float v_width[];
+float r; // curve width
+
+layout(std140, binding = 0) uniform Camera {
+    vec4 q, q_inv;
+    vec2 viewport_size;
+    float zoom_level;
+};
 
 
 
@@ -76,6 +81,7 @@ void build_quad_line(){
 }
 
 void main() {
+    r = v_width[1];
 
     build_quad_line();
 
@@ -1,9 +1,32 @@
 #version 460 core
 
-uniform vec4 q, q_inv;
+layout(std140, binding = 0) uniform Camera {
+    vec4 q, q_inv;
+    vec2 viewport_size;
+    float zoom_level;
+};
+
+struct ObjectData {
+    // object transform and decoding of the packed positions
+    vec3 scale;
+    float width; // curves width
+    vec3 translation;
+    vec4 tint;
+    // scalar to colormap coordinate scale and offset, and colormap layer,
+    // negative for the vertex colors
+    vec4 colormap;
+};
+layout(std430, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+uniform int first_object; // index of the first command of the draw call
+
 layout(location = 0) in vec3 in_pos;        // Vertex position
 layout(location = 1) in vec3 in_color;        // Vertex colors
+layout(location = 2) in float in_scalar;      // Colormapped value
+layout(binding = 0) uniform sampler1DArray colormaps;
 out vec3 v_color;
+out float v_width;
 
 vec4 mul_quatern(vec4 u, vec4 v){
     //u.x, u.y, u.z, u.w = u
@@ -25,8 +48,18 @@ void main()
 {
 
 
-    gl_Position = vec4(rotation(in_pos), 1.0);
-    v_color = in_color;
+    ObjectData object = objects[first_object + gl_DrawID];
+    vec3 world_pos = in_pos * object.scale + object.translation;
+    gl_Position = vec4(rotation(world_pos), 1.0);
+    vec3 vertex_color = in_color;
+    if (object.colormap.z >= 0) {
+        vec2 texture_coord = vec2(
+                in_scalar * object.colormap.x + object.colormap.y,
+                object.colormap.z);
+        vertex_color = texture(colormaps, texture_coord).rgb;
+    }
+    v_color = vertex_color * object.tint.rgb;
+    v_width = object.width;
 
 
 }
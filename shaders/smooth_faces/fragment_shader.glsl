@@ -2,11 +2,32 @@
 
 // Output color
 out vec4 FragColor;
-in vec3 normal;
+in vec3 position;
+in vec3 normal; // interpolated vertex normal
 in vec3 color;
+float ambient_light = 1.2;
+float specular_light_strength = 0.4;
+vec3 light_position = vec3(2,2,2);
 void main()
 {
-    //float intensity =  (1.8 + z)/2.8 * (1.5 + normal.z)/2.5;
-    float intensity =  (1.1 - normal.z)/2.1;
-    FragColor = vec4(color, 1.0)*intensity;
+
+    vec3 x_tangent = dFdx(position);
+    vec3 y_tangent = dFdy(position);
+    vec3 face_normal = normalize( cross( x_tangent, y_tangent ) );
+    // the vertex normal is turned to the side of the face facing the viewer
+    vec3 shading_normal = normalize(normal);
+    if (dot(shading_normal, face_normal) < 0) {
+        shading_normal = -shading_normal;
+    }
+
+    vec3 light_direction = normalize(light_position);
+    float diffusion = dot(light_direction, shading_normal);
+
+    vec3 fragment_view_direction = normalize(vec3(0,0,1)-position);
+    vec3 reflected_light_direction = 2*dot(shading_normal, light_direction)*shading_normal-light_direction;
+    float specular_ligth = pow(max(dot(reflected_light_direction, fragment_view_direction), 0.0), 16);
+    specular_ligth *= specular_light_strength;
+
+    float intensity =  (specular_ligth + ambient_light + diffusion)/(1.0 + ambient_light);
+    FragColor = vec4(color*intensity, 1.0);
 }
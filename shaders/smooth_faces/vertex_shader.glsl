@@ -10,23 +10,66 @@ vec4 mul_quatern(vec4 u, vec4 v){
             v.y * u.z - v.z * u.y + v.w * u.x + v.x * u.w);
 }
 
-uniform vec4 q, q_inv;
-uniform float zoom_level;
+layout(std140, binding = 0) uniform Camera {
+    vec4 q, q_inv;
+    vec2 viewport_size;
+    float zoom_level;
+};
+
+struct ObjectData {
+    // object transform and decoding of the packed positions
+    vec3 scale;
+    float width; // curves width
+    vec3 translation;
+    vec4 tint;
+    // scalar to colormap coordinate scale and offset, and colormap layer,
+    // negative for the vertex colors
+    vec4 colormap;
+};
+layout(std430, binding = 0) readonly buffer Objects {
+    ObjectData objects[];
+};
+uniform int first_object; // index of the first command of the draw call
+
 layout(location = 0) in vec3 in_pos;        // Vertex position
-layout(location = 1) in vec3 in_normal;        // Vertex normal
-layout(location = 2) in vec3 in_color;        // Vertex normal
+layout(location = 1) in vec3 in_color;        // Vertex colors
+layout(location = 2) in float in_scalar;      // Colormapped value
+layout(location = 3) in vec2 in_normal;       // Octahedral vertex normal
+layout(binding = 0) uniform sampler1DArray colormaps;
+out vec3 position;
 out vec3 normal;
 out vec3 color;
+
+vec3 octahedral_decode(vec2 e){
+    // inverse of the octahedral projection of the unit sphere on [-1, 1]^2
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 void main()
 {
-    vec4 normalq =mul_quatern(vec4(0.0, in_normal.xyz), q_inv);
-    normalq = mul_quatern(q, normalq);
-
-    vec4 pos = mul_quatern(vec4(0.0, in_pos.xyz), q_inv);
+    ObjectData object = objects[first_object + gl_DrawID];
+    vec3 world_pos = in_pos * object.scale + object.translation;
+    // rotation
+    vec4 pos = mul_quatern(vec4(0.0, world_pos), q_inv);
     pos = mul_quatern(q, pos);
+    position = pos.yzw;
+    // the object transform has a uniform scale, only the rotation applies
+    vec4 normalq = mul_quatern(vec4(0.0, octahedral_decode(in_normal)), q_inv);
+    normal = mul_quatern(q, normalq).yzw;
+    pos.yz *= -2/(pos.w - 2); // perspective
     pos.yz = pos.yz * zoom_level;
+    pos.y *= viewport_size.y/viewport_size.x; //aspect ratio
     gl_Position = vec4(pos.yzw, 1.0);
-    normal = normalq.yzw;
-    color = in_color;
+    vec3 vertex_color = in_color;
+    if (object.colormap.z >= 0) {
+        vec2 texture_coord = vec2(
+                in_scalar * object.colormap.x + object.colormap.y,
+                object.colormap.z);
+        vertex_color = texture(colormaps, texture_coord).rgb;
+    }
+    color = vertex_color * object.tint.rgb;
 
 }
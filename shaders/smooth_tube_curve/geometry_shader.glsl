@@ -7,9 +7,14 @@ out vec3 normal;
 out vec3 position;
 out vec3 color;
 
-uniform float r;
-uniform float zoom_level;
-uniform vec2 viewport_size;
+in float v_width[];
+float r; // curve width
+
+layout(std140, binding = 0) uniform Camera {
+    vec4 q, q_inv;
+    vec2 viewport_size;
+    float zoom_level;
+};
 
 vec3 normal_vec(vec3 T){
     // Normal vector to the tangent T.
@@ -159,6 +164,7 @@ void build_tube(){
 }
 
 void main() {
+    r = v_width[1];
 
     build_tube();
 
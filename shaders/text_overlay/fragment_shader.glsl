@@ -0,0 +1,24 @@
+#version 460 core
+
+out vec4 FragColor;
+flat in int character;
+in vec2 cell_position;
+
+// 5x7 glyphs, one byte per row from the top, the leftmost pixel in bit 4.
+// Rows 0 to 3 are in x, rows 4 to 6 in y.
+uniform uvec2 font[64];
+
+void main()
+{
+    ivec2 pixel = ivec2(floor(cell_position));
+    bool lit = false;
+    // the glyph is drawn below the first row of the cell
+    int row = pixel.y - 1;
+    if (pixel.x < 5 && row >= 0 && row < 7) {
+        uvec2 glyph = font[character];
+        uint bits = row < 4 ? glyph.x >> (8 * row) : glyph.y >> (8 * (row - 4));
+        lit = ((bits >> (4 - pixel.x)) & 1u) != 0u;
+    }
+    // white text on a translucent background
+    FragColor = lit ? vec4(1.0) : vec4(0.0, 0.0, 0.0, 0.6);
+}
@@ -0,0 +1,26 @@
+#version 460 core
+
+layout(std140, binding = 0) uniform Camera {
+    vec4 q, q_inv;
+    vec2 viewport_size;
+    float zoom_level;
+};
+layout(location = 0) in ivec3 in_char; // column, row, character index
+
+flat out int character;
+out vec2 cell_position; // in font pixels, from the top left of the cell
+
+const vec2 CELL_SIZE = vec2(6, 9); // 5x7 glyph, spacing and line spacing
+const float PIXEL_SIZE = 2.0;
+const vec2 MARGIN = vec2(8, 8);
+
+void main()
+{
+    // one quad per character, drawn as a triangle strip
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    cell_position = corner * CELL_SIZE;
+    vec2 pixel = MARGIN + (vec2(in_char.xy) * CELL_SIZE + cell_position) * PIXEL_SIZE;
+    gl_Position = vec4(2.0 * pixel.x / viewport_size.x - 1.0,
+                       1.0 - 2.0 * pixel.y / viewport_size.y, 0.0, 1.0);
+    character = in_char.z;
+}
@@ -2,6 +2,8 @@
 #define MESH_H_
 #include <vector>
 
+enum class Subdivision { MIDPOINT, LOOP, SQRT3 };
+
 class Mesh {
   // maximum number of adjacent faces to a vertice
   unsigned int n_adja_faces_max{0};
@@ -41,9 +43,37 @@ public:
   void set_face_normals();
   void set_vertex_normals();
   void set_edges();
-  // void set_face_edges();
+  void set_face_edges(); // also sets the edges
   void subdivide();
 
+  // Subdivides levels times, the vertices keep their index, then come the
+  // new vertices ordered by edge (MIDPOINT, LOOP) or by face (SQRT3).
+  // Keeps the edges and face_edges up to date.
+  void subdivide(Subdivision scheme, int levels = 1);
+
+  // Splits the faces where the absolute curvature of a vertex or the edges
+  // length exceed the thresholds (a threshold <= 0 is ignored), the mesh
+  // stays conforming. Returns the number of new vertices.
+  auto refine(const std::vector<double> &vertex_curvature,
+              double curvature_threshold, double edge_length_threshold)
+      -> int;
+
+  // Merges the vertices closer than tolerance and removes the degenerate
+  // faces, returns the number of removed vertices.
+  auto weld_vertices(double tolerance) -> int;
+
+  // Connected component of each face, numbered in order of first face.
+  auto get_face_components() -> std::vector<unsigned int>;
+
+  // One mesh per connected component.
+  auto split_components() -> std::vector<Mesh>;
+
+  // Ordered boundary loops, stored as sublists like the one-ring.
+  auto get_boundary_loops() -> std::vector<unsigned int>;
+
+  // Clears the data derived from the faces (edges, normals, adjacency...)
+  void clear_connectivity();
+
   auto get_face_areas() -> std::vector<double>;
 
   // Takes one_ring as an argument to make explicit that the
@@ -1,8 +1,10 @@
 #include "mesh.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
-#include <set>
 #include <unordered_map>
 #include <vector>
 
@@ -169,108 +171,142 @@ void Mesh::set_vertex_adjacent_faces() {
 }
 
 void Mesh::set_vertex_normals() {
-  if (vertex_adjacent_faces.empty()) {
-    set_vertex_adjacent_faces();
-  }
+  /* Average of the adjacent faces normals. The faces of each vertex are
+   * gathered by a counting sort of the faces vertices, in increasing face
+   * order, then the vertices are summed in parallel. */
   if (face_normals.empty()) {
     set_face_normals();
   }
 
-  vertex_normals.resize(n_vertices * 3, 0);
-  int n_adja{0};
-  int adja_array_idx{0};
-  int face = 0;
+  std::vector<long int> first_face(n_vertices + 1, 0);
+  for (unsigned int v : faces) {
+    ++first_face[v + 1];
+  }
   for (int i = 0; i < n_vertices; ++i) {
-    n_adja = (int)vertex_adjacent_faces.at(adja_array_idx);
-    for (int j = 0; j < n_adja; ++j) {
-      ++adja_array_idx;
-      face = (int)vertex_adjacent_faces.at(adja_array_idx);
+    first_face[i + 1] += first_face[i];
+  }
+  std::vector<long int> next(first_face.begin(), first_face.end() - 1);
+  std::vector<int> vertex_faces(faces.size());
+  for (long int i = 0; i < (long int)faces.size(); ++i) {
+    vertex_faces[next[faces[i]]++] = (int)(i / 3);
+  }
+
+  vertex_normals.assign(n_vertices * 3, 0);
+  Parallel::for_each(n_vertices, [&](long int i) {
+    double *normal = &vertex_normals[i * 3];
+    for (long int j = first_face[i]; j < first_face[i + 1]; ++j) {
       for (int k = 0; k < 3; ++k) {
-        vertex_normals.at(i * 3 + k) += face_normals.at(face * 3 + k);
+        normal[k] += face_normals[vertex_faces[j] * 3 + k];
       }
     }
-
-    normalize(&vertex_normals[i * 3]);
-
-    ++adja_array_idx;
-  }
+    normalize(normal);
+  });
 }
 
 void Mesh::set_face_normals() {
-  /* Computes the normals for each triangular face .*/
+  /* Computes the normals for each triangular face, in parallel. */
   face_normals.resize(faces.size(), 0);
-  unsigned int i{0};
-  unsigned int j{0};
-  unsigned int k{0};
-  double e0[3];
-  double e1[3];
-  for (int face_idx = 0; face_idx < n_faces; ++face_idx) {
-    i = faces.at(3 * face_idx);
-    j = faces.at(3 * face_idx + 1);
-    k = faces.at(3 * face_idx + 2);
-
-    e0[0] = vertices[j * 3] - vertices[i * 3];
-    e0[1] = vertices[j * 3 + 1] - vertices[i * 3 + 1];
-    e0[2] = vertices[j * 3 + 2] - vertices[i * 3 + 2];
-
-    e1[0] = vertices[k * 3] - vertices[i * 3];
-    e1[1] = vertices[k * 3 + 1] - vertices[i * 3 + 1];
-    e1[2] = vertices[k * 3 + 2] - vertices[i * 3 + 2];
+  Parallel::for_each(n_faces, [this](long int face_idx) {
+    unsigned int i = faces[3 * face_idx];
+    unsigned int j = faces[3 * face_idx + 1];
+    unsigned int k = faces[3 * face_idx + 2];
+    double e0[3];
+    double e1[3];
+    for (int l = 0; l < 3; ++l) {
+      e0[l] = vertices[j * 3 + l] - vertices[i * 3 + l];
+      e1[l] = vertices[k * 3 + l] - vertices[i * 3 + l];
+    }
     vector_prod(e0, e1, face_normals.data() + face_idx * 3);
     normalize(face_normals.data() + face_idx * 3);
+  });
+}
+
+static void build_edges(const std::vector<unsigned int> &faces, int n_faces,
+                        int n_vertices, std::vector<unsigned int> &edges,
+                        std::vector<unsigned int> *face_edges) {
+  /* The half-edges are bucketed by their smallest vertex, each bucket is
+   * sorted and made unique, so the edges are in lexicographic order.
+   * If face_edges is not null, it receives the edge of each half-edge. */
+  long int n_half_edges = (long int)n_faces * 3;
+  auto half_edge = [&faces](long int i, unsigned int &v_min,
+                            unsigned int &v_max) {
+    unsigned int a = faces[i];
+    unsigned int b = faces[i - i % 3 + (i + 1) % 3];
+    v_min = a < b ? a : b;
+    v_max = a < b ? b : a;
+  };
+
+  std::vector<std::atomic<unsigned int>> bucket_cursor(n_vertices);
+  Parallel::for_each(n_vertices, [&](long int i) { bucket_cursor[i] = 0; });
+  Parallel::for_each(n_half_edges, [&](long int i) {
+    unsigned int v_min{0};
+    unsigned int v_max{0};
+    half_edge(i, v_min, v_max);
+    bucket_cursor[v_min].fetch_add(1, std::memory_order_relaxed);
+  });
+  std::vector<unsigned int> bucket_begin(n_vertices + 1, 0);
+  for (int i = 0; i < n_vertices; ++i) {
+    bucket_begin[i + 1] = bucket_begin[i] + bucket_cursor[i];
+    bucket_cursor[i] = bucket_begin[i];
+  }
+  std::vector<unsigned int> bucket(n_half_edges);
+  Parallel::for_each(n_half_edges, [&](long int i) {
+    unsigned int v_min{0};
+    unsigned int v_max{0};
+    half_edge(i, v_min, v_max);
+    bucket[bucket_cursor[v_min].fetch_add(1, std::memory_order_relaxed)] =
+        v_max;
+  });
+
+  // unique edges of each bucket, moved to the bucket front
+  std::vector<unsigned int> edge_begin(n_vertices + 1, 0);
+  Parallel::for_each(n_vertices, [&](long int i) {
+    auto begin = bucket.begin() + bucket_begin[i];
+    std::sort(begin, bucket.begin() + bucket_begin[i + 1]);
+    edge_begin[i + 1] =
+        std::unique(begin, bucket.begin() + bucket_begin[i + 1]) - begin;
+  });
+  for (int i = 0; i < n_vertices; ++i) {
+    edge_begin[i + 1] += edge_begin[i];
+  }
+
+  edges.resize(edge_begin[n_vertices] * 2);
+  Parallel::for_each(n_vertices, [&](long int i) {
+    for (unsigned int j = 0; j < edge_begin[i + 1] - edge_begin[i]; ++j) {
+      edges[(edge_begin[i] + j) * 2] = i;
+      edges[(edge_begin[i] + j) * 2 + 1] = bucket[bucket_begin[i] + j];
+    }
+  });
+
+  if (face_edges == nullptr) {
+    return;
   }
+  face_edges->resize(n_half_edges);
+  Parallel::for_each(n_half_edges, [&](long int i) {
+    unsigned int v_min{0};
+    unsigned int v_max{0};
+    half_edge(i, v_min, v_max);
+    auto begin = bucket.begin() + bucket_begin[v_min];
+    auto end = begin + (edge_begin[v_min + 1] - edge_begin[v_min]);
+    (*face_edges)[i] =
+        edge_begin[v_min] + (std::lower_bound(begin, end, v_max) - begin);
+  });
 }
 
 void Mesh::set_edges() {
-  /* Finds the lis of uniques edges of the mesh.
-   * The hashing function is :
-   *  min vertex idx | max vertex idx
-   * [     32 bits   |     32 bits   ]
-   * [      unsigned long long       ]
+  /* Finds the list of uniques edges of the mesh.
+   * Each edge is stored as (min vertex idx, max vertex idx),
+   * the edges are sorted in lexicographic order.
    * */
-  std::set<unsigned long long int> edges_set;
-  unsigned int v[] = {0, 0, 0};
-  unsigned int v_min{0};
-  unsigned int v_max{0};
-  unsigned long long e{0};
-  unsigned long long mask{0};
-  mask = ~mask;
-  mask <<= 32;
-  mask = ~mask;
-
-  for (int i = 0; i < n_faces; ++i) {
-    v[0] = faces.at(i * 3);
-    v[1] = faces.at(i * 3 + 1);
-    v[2] = faces.at(i * 3 + 2);
-
-    v_min = v[0] > v[1] ? v[1] : v[0];
-    v_max = v[0] > v[1] ? v[0] : v[1];
-    e = v_min;
-    e <<= 32;
-    e += v_max;
-    edges_set.insert(e);
-
-    v_min = v[0] > v[2] ? v[2] : v[0];
-    v_max = v[0] > v[2] ? v[0] : v[2];
-    e = v_min;
-    e <<= 32;
-    e += v_max;
-    edges_set.insert(e);
-
-    v_min = v[2] > v[1] ? v[1] : v[2];
-    v_max = v[2] > v[1] ? v[2] : v[1];
-    e = v_min;
-    e <<= 32;
-    e += v_max;
-    edges_set.insert(e);
-  }
-  edges.resize(edges_set.size() * 2);
-  unsigned int i{0};
-  for (const auto &e_set : edges_set) {
-    edges.at(i) = e_set >> 32;
-    edges.at(i + 1) = e_set & mask;
-    i += 2;
-  }
+  build_edges(faces, n_faces, n_vertices, edges, nullptr);
+}
+
+void Mesh::set_face_edges() {
+  /* Sets the edges and the edge index of each face side,
+   * face_edges[face * 3 + k] is the edge between the vertices k and k + 1
+   * of the face.
+   * */
+  build_edges(faces, n_faces, n_vertices, edges, &face_edges);
 }
 
 struct SplitVertice {
@@ -418,6 +454,17 @@ void Mesh::subdivide() {
   set_edges();
 }
 
+void Mesh::clear_connectivity() {
+  /* To be called when faces or vertices are modified. */
+  n_adja_faces_max = 0;
+  edges.clear();
+  face_edges.clear();
+  face_normals.clear();
+  vertex_normals.clear();
+  vertex_adjacent_faces.clear();
+  one_ring.clear();
+}
+
 void normalize(double *w) {
   double inv_norm =
       1.0 / pow(pow(w[0], 2.0) + pow(w[1], 2.0) + pow(w[2], 2.0), 0.5);
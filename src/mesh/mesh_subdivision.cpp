@@ -0,0 +1,457 @@
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+constexpr unsigned int maxuint{~(0U)};
+
+struct SubdivisionAdjacency {
+  /* Faces and vertices around the edges of one subdivision level.
+   * The buffers are allocated once for the largest level. */
+  long int n_vertices{0};
+  // number of faces and two of the half-edges (face * 3 + k) of each edge
+  std::vector<std::atomic<unsigned int>> edge_n_faces;
+  std::vector<unsigned int> edge_half_edges;
+  // edges of each vertex, sorted, vertex_edges[vertex_begin[i]...]
+  std::vector<std::atomic<unsigned int>> vertex_cursor;
+  std::vector<unsigned int> vertex_begin;
+  std::vector<unsigned int> vertex_edges;
+
+  SubdivisionAdjacency(long int max_vertices, long int max_edges)
+      : edge_n_faces(max_edges), edge_half_edges(max_edges * 2),
+        vertex_cursor(max_vertices), vertex_begin(max_vertices + 1),
+        vertex_edges(max_edges * 2) {}
+
+  void set(const Mesh &mesh) {
+    n_vertices = mesh.n_vertices;
+    long int n_edges = (long int)mesh.edges.size() / 2;
+    Parallel::for_each(n_edges, [&](long int e) { edge_n_faces[e] = 0; });
+    Parallel::for_each(n_vertices, [&](long int i) { vertex_cursor[i] = 0; });
+
+    Parallel::for_each((long int)mesh.n_faces * 3, [&](long int h) {
+      unsigned int e = mesh.face_edges[h];
+      unsigned int slot =
+          edge_n_faces[e].fetch_add(1, std::memory_order_relaxed);
+      if (slot < 2) {
+        edge_half_edges[e * 2 + slot] = h;
+      }
+    });
+
+    Parallel::for_each(n_edges * 2, [&](long int i) {
+      vertex_cursor[mesh.edges[i]].fetch_add(1, std::memory_order_relaxed);
+    });
+    vertex_begin[0] = 0;
+    for (long int i = 0; i < n_vertices; ++i) {
+      vertex_begin[i + 1] = vertex_begin[i] + vertex_cursor[i];
+      vertex_cursor[i] = vertex_begin[i];
+    }
+    Parallel::for_each(n_edges * 2, [&](long int i) {
+      vertex_edges[vertex_cursor[mesh.edges[i]].fetch_add(
+          1, std::memory_order_relaxed)] = i / 2;
+    });
+    // sorted for deterministic sums
+    Parallel::for_each(n_vertices, [&](long int i) {
+      std::sort(vertex_edges.begin() + vertex_begin[i],
+                vertex_edges.begin() + vertex_begin[i + 1]);
+    });
+  }
+};
+
+static void smooth_vertex(Subdivision scheme, const Mesh &mesh,
+                          const SubdivisionAdjacency &adjacency, long int i,
+                          double *out) {
+  /* New position of an old vertex. Interior vertices use the weights of the
+   * scheme, the boundary vertices of the Loop scheme follow the cubic
+   * B-spline rule, other boundary vertices and corners are kept. */
+  const double *v = &mesh.vertices[i * 3];
+  std::copy(v, v + 3, out);
+  if (scheme == Subdivision::MIDPOINT) {
+    return;
+  }
+
+  double ring_sum[] = {0, 0, 0};
+  double boundary_sum[] = {0, 0, 0};
+  int n{0};
+  int n_boundary{0};
+  for (unsigned int j = adjacency.vertex_begin[i];
+       j < adjacency.vertex_begin[i + 1]; ++j) {
+    unsigned int e = adjacency.vertex_edges[j];
+    unsigned int other = mesh.edges[e * 2] == i ? mesh.edges[e * 2 + 1]
+                                                : mesh.edges[e * 2];
+    bool boundary = adjacency.edge_n_faces[e] != 2;
+    for (int k = 0; k < 3; ++k) {
+      ring_sum[k] += mesh.vertices[other * 3 + k];
+      if (boundary) {
+        boundary_sum[k] += mesh.vertices[other * 3 + k];
+      }
+    }
+    ++n;
+    n_boundary += boundary;
+  }
+
+  if (n_boundary == 0 && n > 0) {
+    double alpha{0};
+    double cos_n = std::cos(2.0 * M_PI / n);
+    if (scheme == Subdivision::LOOP) {
+      alpha = 5.0 / 8.0 - (3.0 / 8.0 + cos_n / 4.0) * (3.0 / 8.0 + cos_n / 4.0);
+    } else {
+      alpha = (4.0 - 2.0 * cos_n) / 9.0;
+    }
+    for (int k = 0; k < 3; ++k) {
+      out[k] = (1.0 - alpha) * v[k] + alpha * ring_sum[k] / n;
+    }
+  } else if (n_boundary == 2 && scheme == Subdivision::LOOP) {
+    for (int k = 0; k < 3; ++k) {
+      out[k] = 0.75 * v[k] + 0.125 * boundary_sum[k];
+    }
+  }
+}
+
+static void split_edges(Subdivision scheme, const Mesh &mesh,
+                        const SubdivisionAdjacency &adjacency, Mesh &next) {
+  /* One level of 1 to 4 split, the vertex on the edge e has the index
+   * n_vertices + e.
+   * The halves of the edge e are the edges 2e (smallest vertex side) and
+   * 2e + 1, the edge between the new vertices k and k + 1 of the face f is
+   * 2 * n_edges + 3f + k. */
+  const long int n_edges = (long int)mesh.edges.size() / 2;
+  const unsigned int nv = mesh.n_vertices;
+
+  next.n_vertices = (int)(nv + n_edges);
+  next.n_faces = mesh.n_faces * 4;
+  next.vertices.resize((long int)next.n_vertices * 3);
+  next.faces.resize((long int)next.n_faces * 3);
+  next.edges.resize((n_edges * 2 + (long int)mesh.n_faces * 3) * 2);
+  next.face_edges.resize((long int)next.n_faces * 3);
+
+  Parallel::for_each(nv, [&](long int i) {
+    smooth_vertex(scheme, mesh, adjacency, i, &next.vertices[i * 3]);
+  });
+
+  Parallel::for_each(n_edges, [&](long int e) {
+    const double *a = &mesh.vertices[mesh.edges[e * 2] * 3];
+    const double *b = &mesh.vertices[mesh.edges[e * 2 + 1] * 3];
+    double *out = &next.vertices[(nv + e) * 3];
+    if (scheme == Subdivision::LOOP && adjacency.edge_n_faces[e] == 2) {
+      unsigned int h0 = adjacency.edge_half_edges[e * 2];
+      unsigned int h1 = adjacency.edge_half_edges[e * 2 + 1];
+      // vertices opposite to the edge
+      unsigned int c_idx = mesh.faces[h0 - h0 % 3 + (h0 + 2) % 3];
+      unsigned int d_idx = mesh.faces[h1 - h1 % 3 + (h1 + 2) % 3];
+      const double *c = &mesh.vertices[c_idx * 3];
+      const double *d = &mesh.vertices[d_idx * 3];
+      for (int k = 0; k < 3; ++k) {
+        out[k] = 0.375 * (a[k] + b[k]) + 0.125 * (c[k] + d[k]);
+      }
+    } else {
+      for (int k = 0; k < 3; ++k) {
+        out[k] = 0.5 * (a[k] + b[k]);
+      }
+    }
+    next.edges[e * 4] = mesh.edges[e * 2];
+    next.edges[e * 4 + 1] = nv + e;
+    next.edges[e * 4 + 2] = mesh.edges[e * 2 + 1];
+    next.edges[e * 4 + 3] = nv + e;
+  });
+
+  Parallel::for_each(mesh.n_faces, [&](long int f) {
+    const unsigned int *v = &mesh.faces[f * 3];
+    const unsigned int *e = &mesh.face_edges[f * 3];
+    unsigned int m[] = {nv + e[0], nv + e[1], nv + e[2]};
+    unsigned int inner = n_edges * 2 + f * 3; // first inner edge
+
+    for (int k = 0; k < 3; ++k) {
+      // corner face k : v_k, m_k, m_(k+2)
+      int k2 = (k + 2) % 3;
+      unsigned int *face = &next.faces[(f * 4 + k) * 3];
+      face[0] = v[k];
+      face[1] = m[k];
+      face[2] = m[k2];
+      unsigned int *face_edge = &next.face_edges[(f * 4 + k) * 3];
+      face_edge[0] = e[k] * 2 + (mesh.edges[e[k] * 2] == v[k] ? 0 : 1);
+      face_edge[1] = inner + k2;
+      face_edge[2] = e[k2] * 2 + (mesh.edges[e[k2] * 2] == v[k] ? 0 : 1);
+
+      next.edges[(inner + k) * 2] = std::min(m[k], m[(k + 1) % 3]);
+      next.edges[(inner + k) * 2 + 1] = std::max(m[k], m[(k + 1) % 3]);
+    }
+    // center face
+    for (int k = 0; k < 3; ++k) {
+      next.faces[(f * 4 + 3) * 3 + k] = m[k];
+      next.face_edges[(f * 4 + 3) * 3 + k] = inner + k;
+    }
+  });
+}
+
+static void insert_centroids(const Mesh &mesh,
+                             const SubdivisionAdjacency &adjacency,
+                             Mesh &next) {
+  /* One level of sqrt(3) subdivision, the centroid of the face f has the
+   * index n_vertices + f and each interior edge is flipped.
+   * The face 3f + k is made of the vertex k of f and of the flipped edge k,
+   * the edge e becomes the flipped edge (boundary edges are not flipped),
+   * the edge between the vertex k and the centroid of f is n_edges + 3f + k.
+   */
+  const long int n_edges = (long int)mesh.edges.size() / 2;
+  const unsigned int nv = mesh.n_vertices;
+
+  next.n_vertices = (int)(nv + mesh.n_faces);
+  next.n_faces = mesh.n_faces * 3;
+  next.vertices.resize((long int)next.n_vertices * 3);
+  next.faces.resize((long int)next.n_faces * 3);
+  next.edges.resize((n_edges + (long int)mesh.n_faces * 3) * 2);
+  next.face_edges.resize((long int)next.n_faces * 3);
+
+  Parallel::for_each(nv, [&](long int i) {
+    smooth_vertex(Subdivision::SQRT3, mesh, adjacency, i,
+                  &next.vertices[i * 3]);
+  });
+
+  Parallel::for_each(n_edges, [&](long int e) {
+    if (adjacency.edge_n_faces[e] == 2) {
+      unsigned int c0 = nv + adjacency.edge_half_edges[e * 2] / 3;
+      unsigned int c1 = nv + adjacency.edge_half_edges[e * 2 + 1] / 3;
+      next.edges[e * 2] = std::min(c0, c1);
+      next.edges[e * 2 + 1] = std::max(c0, c1);
+    } else {
+      next.edges[e * 2] = mesh.edges[e * 2];
+      next.edges[e * 2 + 1] = mesh.edges[e * 2 + 1];
+    }
+  });
+
+  Parallel::for_each(mesh.n_faces, [&](long int f) {
+    const unsigned int *v = &mesh.faces[f * 3];
+    const unsigned int c = nv + f;
+    double *centroid = &next.vertices[c * 3];
+    for (int k = 0; k < 3; ++k) {
+      centroid[k] = (mesh.vertices[v[0] * 3 + k] + mesh.vertices[v[1] * 3 + k] +
+                     mesh.vertices[v[2] * 3 + k]) /
+                    3.0;
+      next.edges[(n_edges + f * 3 + k) * 2] = v[k];
+      next.edges[(n_edges + f * 3 + k) * 2 + 1] = c;
+    }
+
+    for (int k = 0; k < 3; ++k) {
+      unsigned int e = mesh.face_edges[f * 3 + k];
+      unsigned int *face = &next.faces[(f * 3 + k) * 3];
+      unsigned int *face_edge = &next.face_edges[(f * 3 + k) * 3];
+      if (adjacency.edge_n_faces[e] == 2) {
+        // (v_k, c_other, c), the other face goes along the edge from v_k+1
+        // to v_k
+        unsigned int other = adjacency.edge_half_edges[e * 2];
+        if (other == f * 3 + k) {
+          other = adjacency.edge_half_edges[e * 2 + 1];
+        }
+        unsigned int other_face = other / 3;
+        face[0] = v[k];
+        face[1] = nv + other_face;
+        face[2] = c;
+        face_edge[0] = n_edges + other_face * 3 + (other + 1) % 3;
+        face_edge[1] = e;
+        face_edge[2] = n_edges + f * 3 + k;
+      } else {
+        face[0] = v[k];
+        face[1] = v[(k + 1) % 3];
+        face[2] = c;
+        face_edge[0] = e;
+        face_edge[1] = n_edges + f * 3 + (k + 1) % 3;
+        face_edge[2] = n_edges + f * 3 + k;
+      }
+    }
+  });
+}
+
+void Mesh::subdivide(Subdivision scheme, int levels) {
+  /* The new vertices of a level only depend on the edges and faces indices,
+   * so the numbering does not depend on the number of threads.
+   * The buffers are allocated once for the last level, each level is
+   * computed in a second mesh and the two meshes are swapped. */
+  if (levels < 1 || n_faces == 0) {
+    return;
+  }
+  if (face_edges.size() != faces.size() || edges.empty()) {
+    set_face_edges();
+  }
+
+  // sizes after the last level
+  long int max_vertices = n_vertices;
+  long int max_faces = n_faces;
+  long int max_edges = (long int)edges.size() / 2;
+  for (int l = 0; l < levels; ++l) {
+    if (scheme == Subdivision::SQRT3) {
+      max_vertices += max_faces;
+      max_edges += max_faces * 3;
+      max_faces *= 3;
+    } else {
+      max_vertices += max_edges;
+      max_edges = max_edges * 2 + max_faces * 3;
+      max_faces *= 4;
+    }
+  }
+  if (max_faces * 3 > std::numeric_limits<int>::max()) {
+    std::cout << "Error, too many subdivision levels\n";
+    exit(1);
+  }
+
+  Mesh next;
+  for (Mesh *m : {this, &next}) {
+    m->vertices.reserve(max_vertices * 3);
+    m->faces.reserve(max_faces * 3);
+    m->edges.reserve(max_edges * 2);
+    m->face_edges.reserve(max_faces * 3);
+  }
+  SubdivisionAdjacency adjacency(max_vertices, max_edges);
+
+  for (int l = 0; l < levels; ++l) {
+    adjacency.set(*this);
+    if (scheme == Subdivision::SQRT3) {
+      insert_centroids(*this, adjacency, next);
+    } else {
+      split_edges(scheme, *this, adjacency, next);
+    }
+    std::swap(vertices, next.vertices);
+    std::swap(faces, next.faces);
+    std::swap(edges, next.edges);
+    std::swap(face_edges, next.face_edges);
+    n_vertices = next.n_vertices;
+    n_faces = next.n_faces;
+  }
+
+  std::vector<unsigned int> level_edges(std::move(edges));
+  std::vector<unsigned int> level_face_edges(std::move(face_edges));
+  clear_connectivity();
+  edges = std::move(level_edges);
+  face_edges = std::move(level_face_edges);
+}
+
+auto Mesh::refine(const std::vector<double> &vertex_curvature,
+                  double curvature_threshold, double edge_length_threshold)
+    -> int {
+  /* Red-green refinement, the marked edges are split in their middle.
+   * A face with two or more marked edges gets its three edges marked, until
+   * no face has exactly two marked edges. The faces with three marked edges
+   * are split in 4 (red), the faces with one in 2 (green).
+   * The children of a face follow each other, in the order of the faces,
+   * and the new vertices are ordered by edge. */
+  if (vertex_curvature.size() != (long unsigned int)n_vertices) {
+    std::cout << "Error, vertex_curvature should be of size n_vertices\n";
+    exit(1);
+  }
+  if (face_edges.size() != faces.size() || edges.empty()) {
+    set_face_edges();
+  }
+  const long int n_edges = (long int)edges.size() / 2;
+  const double length_threshold2 =
+      edge_length_threshold * edge_length_threshold;
+
+  std::vector<std::atomic<bool>> split(n_edges);
+  Parallel::for_each(n_edges, [&](long int e) {
+    double length2{0};
+    for (int k = 0; k < 3; ++k) {
+      double d = vertices[edges[e * 2] * 3 + k] -
+                 vertices[edges[e * 2 + 1] * 3 + k];
+      length2 += d * d;
+    }
+    split[e] = edge_length_threshold > 0 && length2 > length_threshold2;
+  });
+  Parallel::for_each(n_faces, [&](long int f) {
+    if (curvature_threshold <= 0) {
+      return;
+    }
+    for (int k = 0; k < 3; ++k) {
+      if (std::abs(vertex_curvature[faces[f * 3 + k]]) >
+          curvature_threshold) {
+        for (int j = 0; j < 3; ++j) {
+          split[face_edges[f * 3 + j]] = true;
+        }
+        return;
+      }
+    }
+  });
+
+  // closure, a face with two split edges becomes red
+  auto n_split = [&](long int f) {
+    return (int)split[face_edges[f * 3]] + (int)split[face_edges[f * 3 + 1]] +
+           (int)split[face_edges[f * 3 + 2]];
+  };
+  std::atomic<bool> changed{true};
+  while (changed) {
+    changed = false;
+    Parallel::for_each(n_faces, [&](long int f) {
+      if (n_split(f) == 2) {
+        for (int k = 0; k < 3; ++k) {
+          split[face_edges[f * 3 + k]] = true;
+        }
+        changed = true;
+      }
+    });
+  }
+
+  // index of the new vertex of each split edge
+  std::vector<unsigned int> edge_vertex(n_edges, maxuint);
+  unsigned int n_new_vertices{0};
+  for (long int e = 0; e < n_edges; ++e) {
+    if (split[e]) {
+      edge_vertex[e] = n_vertices + n_new_vertices++;
+    }
+  }
+  // first child of each face
+  std::vector<unsigned int> face_offset(n_faces + 1, 0);
+  for (int f = 0; f < n_faces; ++f) {
+    int n = n_split(f);
+    face_offset[f + 1] = face_offset[f] + (n == 0 ? 1 : n + 1);
+  }
+
+  std::vector<double> new_vertices(
+      ((long int)n_vertices + n_new_vertices) * 3);
+  std::copy(vertices.begin(), vertices.end(), new_vertices.begin());
+  Parallel::for_each(n_edges, [&](long int e) {
+    if (edge_vertex[e] != maxuint) {
+      for (int k = 0; k < 3; ++k) {
+        new_vertices[edge_vertex[e] * 3 + k] =
+            0.5 * (vertices[edges[e * 2] * 3 + k] +
+                   vertices[edges[e * 2 + 1] * 3 + k]);
+      }
+    }
+  });
+
+  std::vector<unsigned int> new_faces((long int)face_offset[n_faces] * 3);
+  Parallel::for_each(n_faces, [&](long int f) {
+    const unsigned int *v = &faces[f * 3];
+    unsigned int m[3];
+    int split_side{-1};
+    for (int k = 0; k < 3; ++k) {
+      m[k] = edge_vertex[face_edges[f * 3 + k]];
+      if (m[k] != maxuint) {
+        split_side = k;
+      }
+    }
+    unsigned int *child = &new_faces[(long int)face_offset[f] * 3];
+    int n_children = (int)(face_offset[f + 1] - face_offset[f]);
+    if (n_children == 1) {
+      std::copy(v, v + 3, child);
+    } else if (n_children == 2) {
+      // green, bisection of the split side k
+      int k = split_side;
+      unsigned int green[] = {v[k], m[k],           v[(k + 2) % 3],
+                              m[k], v[(k + 1) % 3], v[(k + 2) % 3]};
+      std::copy(green, green + 6, child);
+    } else {
+      // red, same split as subdivide
+      unsigned int red[] = {v[0], m[0], m[2], v[1], m[1], m[0],
+                            v[2], m[2], m[1], m[0], m[1], m[2]};
+      std::copy(red, red + 12, child);
+    }
+  });
+
+  vertices = std::move(new_vertices);
+  faces = std::move(new_faces);
+  n_vertices += (int)n_new_vertices;
+  n_faces = (int)face_offset[n_faces];
+  clear_connectivity();
+  return (int)n_new_vertices;
+}
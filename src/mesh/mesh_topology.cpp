@@ -0,0 +1,524 @@
+#include "mesh.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+constexpr unsigned int maxuint{~(0U)};
+constexpr double CELL_TOLERANCE_RATIO{8}; // welding grid cell size
+
+struct GridCell {
+  // Integer coordinates of a cell of the uniform grid.
+  int64_t x{0};
+  int64_t y{0};
+  int64_t z{0};
+  auto operator==(const GridCell &other) const -> bool {
+    return (x == other.x && y == other.y && z == other.z);
+  }
+};
+
+struct GridCellHash {
+  auto operator()(const GridCell cell) const -> size_t {
+    // splitmix64 finalizer on a combination of the coordinates
+    uint64_t h = (uint64_t)cell.x * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t)cell.y * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (uint64_t)cell.z * 0x165667B19E3779F9ULL;
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+  }
+};
+
+class CellTable {
+  /* Open addressing hash table, cell -> first vertex of the cell. */
+  std::vector<GridCell> keys;
+  std::vector<unsigned int> values;
+  size_t mask{0};
+
+public:
+  void reserve(size_t n) {
+    size_t capacity{16};
+    while (capacity < 2 * n) {
+      capacity <<= 1;
+    }
+    keys.resize(capacity);
+    values.assign(capacity, maxuint);
+    mask = capacity - 1;
+  }
+
+  // Returns the value slot of the cell, inserts the cell if not present.
+  auto operator[](const GridCell &cell) -> unsigned int & {
+    size_t slot = GridCellHash{}(cell) & mask;
+    while (values[slot] != maxuint && !(keys[slot] == cell)) {
+      slot = (slot + 1) & mask;
+    }
+    keys[slot] = cell;
+    return values[slot];
+  }
+
+  [[nodiscard]] auto find(const GridCell &cell) const -> unsigned int {
+    size_t slot = GridCellHash{}(cell) & mask;
+    while (values[slot] != maxuint) {
+      if (keys[slot] == cell) {
+        return values[slot];
+      }
+      slot = (slot + 1) & mask;
+    }
+    return maxuint;
+  }
+};
+
+static auto grid_cell(const double *vertex, double cell_size) -> GridCell {
+  /* With a null cell size, each distinct position has its own cell. */
+  GridCell cell;
+  if (cell_size > 0) {
+    cell.x = (int64_t)std::floor(vertex[0] / cell_size);
+    cell.y = (int64_t)std::floor(vertex[1] / cell_size);
+    cell.z = (int64_t)std::floor(vertex[2] / cell_size);
+  } else {
+    double p[] = {vertex[0] + 0.0, vertex[1] + 0.0, vertex[2] + 0.0}; // -0
+    std::memcpy(&cell.x, &p[0], sizeof(double));
+    std::memcpy(&cell.y, &p[1], sizeof(double));
+    std::memcpy(&cell.z, &p[2], sizeof(double));
+  }
+  return cell;
+}
+
+static auto exclusive_scan(std::vector<long int> &counts) -> long int {
+  /* Replaces the counts by their offsets, returns the total. */
+  long int total{0};
+  long int count{0};
+  for (auto &c : counts) {
+    count = c;
+    c = total;
+    total += count;
+  }
+  return total;
+}
+
+auto Mesh::weld_vertices(double tolerance) -> int {
+  /* Merges the vertices closer than tolerance, remaps the faces and removes
+   * the faces which become degenerate.
+   * The vertices are hashed in a uniform grid, each vertex is merged with
+   * the smallest index vertex within tolerance found in its cell or in the
+   * adjacent cells closer than the tolerance. The merged vertices keep the
+   * position and the order of their first occurrence.
+   * Returns the number of removed vertices. */
+
+  if (tolerance < 0) {
+    std::cout << "Error, the welding tolerance should be positive\n";
+    exit(1);
+  }
+
+  const int n_chunks = Parallel::n_threads();
+  const double tolerance2 = tolerance * tolerance;
+  const double cell_size = CELL_TOLERANCE_RATIO * tolerance;
+
+  // The grid is split in n_chunks partitions by cell hash, each partition
+  // is a hash table (cell -> last vertex) built by one thread.
+  // Vertices of a same cell are linked in next_in_cell.
+  std::vector<GridCell> cells(n_vertices);
+  std::vector<int> cell_partition(n_vertices);
+  Parallel::for_each(n_vertices, [&](long int i) {
+    cells[i] = grid_cell(&vertices[i * 3], cell_size);
+    cell_partition[i] = (int)(GridCellHash{}(cells[i]) % n_chunks);
+  });
+
+  // counting sort of the vertices by partition, chunk by chunk
+  std::vector<long int> partition_offsets((size_t)n_chunks * n_chunks, 0);
+  Parallel::for_chunks(n_vertices, n_chunks,
+                       [&](long int begin, long int end, int chunk) {
+                         for (long int i = begin; i < end; ++i) {
+                           ++partition_offsets[cell_partition[i] * n_chunks +
+                                               chunk];
+                         }
+                       });
+  exclusive_scan(partition_offsets);
+  std::vector<unsigned int> sorted_vertices(n_vertices);
+  Parallel::for_chunks(
+      n_vertices, n_chunks, [&](long int begin, long int end, int chunk) {
+        for (long int i = begin; i < end; ++i) {
+          sorted_vertices[partition_offsets[cell_partition[i] * n_chunks +
+                                            chunk]++] = i;
+        }
+      });
+
+  std::vector<CellTable> grid(n_chunks);
+  std::vector<unsigned int> next_in_cell(n_vertices, maxuint);
+  Parallel::for_chunks(n_chunks, n_chunks, [&](long int, long int,
+                                               int partition) {
+    long int begin =
+        partition == 0 ? 0 : partition_offsets[partition * n_chunks - 1];
+    long int end = partition_offsets[(partition + 1) * n_chunks - 1];
+    auto &table = grid[partition];
+    table.reserve(end - begin);
+    for (long int k = begin; k < end; ++k) {
+      unsigned int i = sorted_vertices[k];
+      unsigned int &first = table[cells[i]];
+      next_in_cell[i] = first;
+      first = i;
+    }
+  });
+
+  // Each vertex points to the smallest vertex index in its neighbourhood.
+  // Cells are larger than the tolerance, on each axis an adjacent cell is
+  // only searched if the vertex is closer than the tolerance to its border.
+  std::vector<unsigned int> welded(n_vertices);
+  Parallel::for_each(n_vertices, [&](long int i) {
+    unsigned int target = i;
+    int side[3] = {0, 0, 0};
+    if (tolerance > 0) {
+      for (int k = 0; k < 3; ++k) {
+        double position = vertices[i * 3 + k] / cell_size;
+        position -= std::floor(position);
+        if (position * CELL_TOLERANCE_RATIO < 1.0) {
+          side[k] = -1;
+        } else if ((1.0 - position) * CELL_TOLERANCE_RATIO < 1.0) {
+          side[k] = 1;
+        }
+      }
+    }
+    GridCell neighbour;
+    for (int dx = 0; dx <= std::abs(side[0]); ++dx) {
+      for (int dy = 0; dy <= std::abs(side[1]); ++dy) {
+        for (int dz = 0; dz <= std::abs(side[2]); ++dz) {
+          neighbour = {cells[i].x + dx * side[0], cells[i].y + dy * side[1],
+                       cells[i].z + dz * side[2]};
+          for (unsigned int j =
+                   grid[GridCellHash{}(neighbour) % n_chunks].find(neighbour);
+               j != maxuint; j = next_in_cell[j]) {
+            if (j >= target) {
+              continue;
+            }
+            double d2{0};
+            for (int k = 0; k < 3; ++k) {
+              d2 += (vertices[j * 3 + k] - vertices[i * 3 + k]) *
+                    (vertices[j * 3 + k] - vertices[i * 3 + k]);
+            }
+            if (d2 <= tolerance2) {
+              target = j;
+            }
+          }
+        }
+      }
+    }
+    welded[i] = target;
+  });
+  grid.clear();
+
+  // Follows the chains of merged vertices, welded[i] <= i so the targets are
+  // already resolved.
+  for (long int i = 0; i < n_vertices; ++i) {
+    welded[i] = welded[welded[i]];
+  }
+
+  // new indices of the kept vertices
+  std::vector<long int> chunk_offsets(n_chunks, 0);
+  Parallel::for_chunks(n_vertices, n_chunks,
+                       [&](long int begin, long int end, int chunk) {
+                         for (long int i = begin; i < end; ++i) {
+                           chunk_offsets[chunk] += (welded[i] == i);
+                         }
+                       });
+  long int n_new_vertices = exclusive_scan(chunk_offsets);
+
+  std::vector<unsigned int> new_index(n_vertices);
+  std::vector<double> new_vertices(n_new_vertices * 3);
+  Parallel::for_chunks(
+      n_vertices, n_chunks, [&](long int begin, long int end, int chunk) {
+        long int idx = chunk_offsets[chunk];
+        for (long int i = begin; i < end; ++i) {
+          if (welded[i] == i) {
+            new_index[i] = idx;
+            std::copy(vertices.begin() + i * 3, vertices.begin() + i * 3 + 3,
+                      new_vertices.begin() + idx * 3);
+            ++idx;
+          }
+        }
+      });
+
+  // remaps the faces and removes the degenerate ones
+  std::fill(chunk_offsets.begin(), chunk_offsets.end(), 0);
+  Parallel::for_chunks(n_faces, n_chunks,
+                       [&](long int begin, long int end, int chunk) {
+                         unsigned int v[3];
+                         for (long int i = begin; i < end; ++i) {
+                           for (int k = 0; k < 3; ++k) {
+                             v[k] = new_index[welded[faces[i * 3 + k]]];
+                             faces[i * 3 + k] = v[k];
+                           }
+                           chunk_offsets[chunk] +=
+                               (v[0] != v[1] && v[1] != v[2] && v[2] != v[0]);
+                         }
+                       });
+  long int n_new_faces = exclusive_scan(chunk_offsets);
+
+  std::vector<unsigned int> new_faces(n_new_faces * 3);
+  Parallel::for_chunks(
+      n_faces, n_chunks, [&](long int begin, long int end, int chunk) {
+        long int idx = chunk_offsets[chunk];
+        for (long int i = begin; i < end; ++i) {
+          if (faces[i * 3] != faces[i * 3 + 1] &&
+              faces[i * 3 + 1] != faces[i * 3 + 2] &&
+              faces[i * 3 + 2] != faces[i * 3]) {
+            std::copy(faces.begin() + i * 3, faces.begin() + i * 3 + 3,
+                      new_faces.begin() + idx * 3);
+            ++idx;
+          }
+        }
+      });
+
+  int n_removed = n_vertices - (int)n_new_vertices;
+  vertices = std::move(new_vertices);
+  faces = std::move(new_faces);
+  n_vertices = (int)n_new_vertices;
+  n_faces = (int)n_new_faces;
+  clear_connectivity();
+  return n_removed;
+}
+
+static auto find_root(std::vector<std::atomic<unsigned int>> &parent,
+                      unsigned int x) -> unsigned int {
+  /* Path halving, the parents only decrease so concurrent updates are safe,
+   * a failed exchange means another thread already shortened the path. */
+  unsigned int p = parent[x].load();
+  while (p != x) {
+    unsigned int gp = parent[p].load();
+    if (gp != p) {
+      unsigned int expected = p;
+      parent[x].compare_exchange_weak(expected, gp);
+    }
+    x = p;
+    p = parent[x].load();
+  }
+  return x;
+}
+
+static void unite(std::vector<std::atomic<unsigned int>> &parent,
+                  unsigned int a, unsigned int b) {
+  /* Lock-free union, the largest root is linked to the smallest, so the root
+   * of a set is its smallest vertex. */
+  while (true) {
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if (a == b) {
+      return;
+    }
+    if (a < b) {
+      std::swap(a, b);
+    }
+    unsigned int expected = a;
+    if (parent[a].compare_exchange_strong(expected, b)) {
+      return;
+    }
+  }
+}
+
+static auto label_components(const Mesh &mesh,
+                             std::vector<unsigned int> &vertex_component,
+                             std::vector<unsigned int> &face_component)
+    -> unsigned int {
+  /* Union-find over the faces vertices. The components are numbered in the
+   * order of their first face, the vertices without faces get maxuint.
+   * Returns the number of components. */
+  std::vector<std::atomic<unsigned int>> parent(mesh.n_vertices);
+  Parallel::for_each(mesh.n_vertices, [&](long int i) { parent[i].store(i); });
+  Parallel::for_each(mesh.n_faces, [&](long int i) {
+    unite(parent, mesh.faces[i * 3], mesh.faces[i * 3 + 1]);
+    unite(parent, mesh.faces[i * 3 + 1], mesh.faces[i * 3 + 2]);
+  });
+
+  std::vector<unsigned int> root(mesh.n_vertices);
+  Parallel::for_each(mesh.n_vertices,
+                     [&](long int i) { root[i] = find_root(parent, i); });
+
+  std::vector<unsigned int> root_component(mesh.n_vertices, maxuint);
+  face_component.resize(mesh.n_faces);
+  unsigned int n_components{0};
+  for (int i = 0; i < mesh.n_faces; ++i) {
+    unsigned int &component = root_component[root[mesh.faces[i * 3]]];
+    if (component == maxuint) {
+      component = n_components++;
+    }
+    face_component[i] = component;
+  }
+
+  vertex_component.resize(mesh.n_vertices);
+  Parallel::for_each(mesh.n_vertices, [&](long int i) {
+    vertex_component[i] = root_component[root[i]];
+  });
+  return n_components;
+}
+
+auto Mesh::get_face_components() -> std::vector<unsigned int> {
+  /* Returns the connected component of each face, two faces are connected
+   * if they share a vertex. */
+  std::vector<unsigned int> vertex_component;
+  std::vector<unsigned int> face_component;
+  label_components(*this, vertex_component, face_component);
+  return face_component;
+}
+
+auto Mesh::split_components() -> std::vector<Mesh> {
+  /* Returns one mesh per connected component, the vertices and faces keep
+   * their relative order. The vertices without faces are dropped. */
+  std::vector<unsigned int> vertex_component;
+  std::vector<unsigned int> face_component;
+  unsigned int n_components =
+      label_components(*this, vertex_component, face_component);
+
+  // index of the vertices and faces in their component
+  std::vector<unsigned int> local_vertex(n_vertices);
+  std::vector<unsigned int> local_face(n_faces);
+  std::vector<int> component_vertices(n_components, 0);
+  std::vector<int> component_faces(n_components, 0);
+  for (int i = 0; i < n_vertices; ++i) {
+    if (vertex_component[i] != maxuint) {
+      local_vertex[i] = component_vertices[vertex_component[i]]++;
+    }
+  }
+  for (int i = 0; i < n_faces; ++i) {
+    local_face[i] = component_faces[face_component[i]]++;
+  }
+
+  std::vector<Mesh> components(n_components);
+  for (unsigned int c = 0; c < n_components; ++c) {
+    components[c].n_vertices = component_vertices[c];
+    components[c].n_faces = component_faces[c];
+    components[c].vertices.resize(component_vertices[c] * 3);
+    components[c].faces.resize(component_faces[c] * 3);
+  }
+
+  Parallel::for_each(n_vertices, [&](long int i) {
+    if (vertex_component[i] != maxuint) {
+      std::copy(vertices.begin() + i * 3, vertices.begin() + i * 3 + 3,
+                components[vertex_component[i]].vertices.begin() +
+                    local_vertex[i] * 3);
+    }
+  });
+  Parallel::for_each(n_faces, [&](long int i) {
+    auto &mesh_faces = components[face_component[i]].faces;
+    for (int k = 0; k < 3; ++k) {
+      mesh_faces[local_face[i] * 3 + k] = local_vertex[faces[i * 3 + k]];
+    }
+  });
+  return components;
+}
+
+auto Mesh::get_boundary_loops() -> std::vector<unsigned int> {
+  /* Boundary edges are the edges of a single face, the loops follow the
+   * orientation of the faces.
+   * The loops are stored as a contiguous list of sublists, like the
+   * one-ring, each sublist starts with the number of vertices in the loop,
+   * followed by the vertices indices.
+   * On a non-manifold boundary a loop may be an open chain. */
+
+  // The half-edges are bucketed by their smallest vertex, an edge is on the
+  // boundary if its largest vertex appears once in the bucket.
+  std::vector<std::atomic<unsigned int>> bucket_offsets(n_vertices + 1);
+  Parallel::for_each(n_vertices + 1,
+                     [&](long int i) { bucket_offsets[i].store(0); });
+  Parallel::for_each((long int)n_faces * 3, [&](long int i) {
+    unsigned int a = faces[i];
+    unsigned int b = faces[i - i % 3 + (i + 1) % 3];
+    bucket_offsets[a < b ? a : b].fetch_add(1, std::memory_order_relaxed);
+  });
+  unsigned int offset{0};
+  for (auto &bucket_offset : bucket_offsets) {
+    offset += bucket_offset.exchange(offset, std::memory_order_relaxed);
+  }
+  // order inside a bucket does not matter
+  std::vector<unsigned int> bucket_max_vertex((long int)n_faces * 3);
+  Parallel::for_each((long int)n_faces * 3, [&](long int i) {
+    unsigned int a = faces[i];
+    unsigned int b = faces[i - i % 3 + (i + 1) % 3];
+    bucket_max_vertex[bucket_offsets[a < b ? a : b].fetch_add(
+        1, std::memory_order_relaxed)] = a < b ? b : a;
+  });
+  // bucket_offsets[v] is now the end of the bucket v
+
+  auto is_boundary = [&](long int i) {
+    unsigned int a = faces[i];
+    unsigned int b = faces[i - i % 3 + (i + 1) % 3];
+    unsigned int v_min = a < b ? a : b;
+    unsigned int v_max = a < b ? b : a;
+    unsigned int begin{0};
+    if (v_min > 0) {
+      begin = bucket_offsets[v_min - 1].load(std::memory_order_relaxed);
+    }
+    unsigned int end = bucket_offsets[v_min].load(std::memory_order_relaxed);
+    int count{0};
+    for (unsigned int j = begin; j < end; ++j) {
+      count += (bucket_max_vertex[j] == v_max);
+    }
+    return count == 1;
+  };
+
+  // boundary half-edges, source | target
+  const int n_chunks = Parallel::n_threads();
+  std::vector<long int> chunk_offsets(n_chunks, 0);
+  Parallel::for_chunks((long int)n_faces * 3, n_chunks,
+                       [&](long int begin, long int end, int chunk) {
+                         for (long int i = begin; i < end; ++i) {
+                           chunk_offsets[chunk] += is_boundary(i);
+                         }
+                       });
+  long int n_boundary = exclusive_scan(chunk_offsets);
+  std::vector<unsigned long long int> half_edges(n_boundary);
+  Parallel::for_chunks((long int)n_faces * 3, n_chunks,
+                       [&](long int begin, long int end, int chunk) {
+                         long int idx = chunk_offsets[chunk];
+                         for (long int i = begin; i < end; ++i) {
+                           if (is_boundary(i)) {
+                             half_edges[idx++] =
+                                 ((unsigned long long int)faces[i] << 32) +
+                                 faces[i - i % 3 + (i + 1) % 3];
+                           }
+                         }
+                       });
+  std::sort(half_edges.begin(), half_edges.end());
+
+  // walks along the half-edges, starting from the smallest unused one
+  std::vector<unsigned int> loops;
+  loops.reserve(n_boundary * 2);
+  std::vector<bool> used(n_boundary, false);
+  for (long int i = 0; i < n_boundary; ++i) {
+    if (used[i]) {
+      continue;
+    }
+    long int count_idx = (long int)loops.size();
+    loops.push_back(0);
+    unsigned int start = half_edges[i] >> 32;
+    long int current = i;
+    while (current >= 0) {
+      used[current] = true;
+      loops.push_back(half_edges[current] >> 32);
+      unsigned int target = half_edges[current] & 0xFFFFFFFFULL;
+      current = -1;
+      if (target == start) {
+        break;
+      }
+      long int next = std::lower_bound(half_edges.begin(), half_edges.end(),
+                                       (unsigned long long int)target << 32) -
+                      half_edges.begin();
+      for (; next < n_boundary && (half_edges[next] >> 32) == target; ++next) {
+        if (!used[next]) {
+          current = next;
+          break;
+        }
+      }
+      if (current < 0) {
+        loops.push_back(target); // open chain
+      }
+    }
+    loops[count_idx] = (unsigned int)loops.size() - count_idx - 1;
+  }
+  return loops;
+}
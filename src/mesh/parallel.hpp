@@ -0,0 +1,88 @@
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+/* Minimal thread helpers for the mesh operators. */
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+
+inline auto n_threads() -> int {
+  int n = (int)std::thread::hardware_concurrency();
+  return n > 0 ? n : 1;
+}
+
+// First element of the chunk chunk_idx when [0, n) is split in n_chunks.
+inline auto chunk_begin(long int n, int n_chunks, int chunk_idx) -> long int {
+  return n * chunk_idx / n_chunks;
+}
+
+template <class F> void for_chunks(long int n, int n_chunks, F function) {
+  /* Calls function(begin, end, chunk_idx) on n_chunks contiguous chunks of
+   * [0, n), one thread per chunk. */
+  if (n_chunks <= 1) {
+    function(0L, n, 0);
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(n_chunks);
+  for (int i = 0; i < n_chunks; ++i) {
+    threads.emplace_back(function, chunk_begin(n, n_chunks, i),
+                         chunk_begin(n, n_chunks, i + 1), i);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+// Number of chunks of for_chunks(n, function), small ranges are not worth
+// a thread.
+inline auto n_chunks(long int n) -> int {
+  constexpr long int min_chunk{4096};
+  long int n_chunks = n / min_chunk + 1;
+  return n_chunks < n_threads() ? (int)n_chunks : n_threads();
+}
+
+template <class F> void for_chunks(long int n, F function) {
+  for_chunks(n, n_chunks(n), function);
+}
+
+template <class F> void for_each(long int n, F function) {
+  /* Calls function(i) for i in [0, n) in parallel. */
+  for_chunks(n, [&function](long int begin, long int end, int) {
+    for (long int i = begin; i < end; ++i) {
+      function(i);
+    }
+  });
+}
+
+template <class F>
+void for_each_range(const std::vector<long int> &offsets, F function) {
+  /* Calls function(i) for each range [offsets[i], offsets[i + 1]) in
+   * parallel, the chunks are balanced by the total size of their ranges. */
+  auto n_ranges = (long int)offsets.size() - 1;
+  if (n_ranges < 1) {
+    return;
+  }
+  long int n = offsets.back() - offsets.front();
+  int chunks = n_chunks(n);
+  // first range of each chunk, the ranges starting in the chunk elements
+  std::vector<long int> first_range(chunks + 1, n_ranges);
+  for (int i = 1; i < chunks; ++i) {
+    long int begin = offsets.front() + chunk_begin(n, chunks, i);
+    first_range[i] =
+        std::lower_bound(offsets.begin(), offsets.end() - 1, begin) -
+        offsets.begin();
+  }
+  first_range[0] = 0;
+  for_chunks(n_ranges, chunks, [&](long int, long int, int chunk_idx) {
+    for (long int i = first_range[chunk_idx]; i < first_range[chunk_idx + 1];
+         ++i) {
+      function(i);
+    }
+  });
+}
+
+} // namespace Parallel
+
+#endif // PARALLEL_H_
@@ -0,0 +1,63 @@
+/* test implementation */
+#include "../mesh.hpp"
+#include <iostream>
+#include <vector>
+
+void print_loops(std::vector<unsigned int> &loops) {
+  for (unsigned int i = 0; i < loops.size(); i += loops.at(i) + 1) {
+    std::cout << "loop : ";
+    for (unsigned int j = 1; j <= loops.at(i); ++j) {
+      std::cout << loops.at(i + j) << " , ";
+    }
+    std::cout << "\n";
+  }
+}
+
+auto main() -> int {
+  std::cout << "\n++++++++ Test components +++++++\n\n";
+
+  // A closed cube, an open cube and an isolated vertex in the same mesh,
+  // the faces of the two cubes are interleaved.
+  Mesh cube = Primitives::cube();
+  std::vector<double> vertices(cube.vertices);
+  for (int i = 0; i < cube.n_vertices * 3; ++i) {
+    vertices.push_back(cube.vertices.at(i) + (i % 3 == 0 ? 2.0 : 0.0));
+  }
+  vertices.insert(vertices.end(), {-5, -5, -5});
+  std::vector<unsigned int> faces;
+  for (int i = 0; i < cube.n_faces; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      faces.push_back(cube.faces.at(i * 3 + k));
+    }
+    if (i < cube.n_faces - 2) {
+      for (int k = 0; k < 3; ++k) {
+        faces.push_back(cube.faces.at(i * 3 + k) + cube.n_vertices);
+      }
+    }
+  }
+
+  Mesh mesh(vertices, faces);
+  std::vector<unsigned int> face_components = mesh.get_face_components();
+  std::cout << "face components : ";
+  for (auto c : face_components) {
+    std::cout << c << " , ";
+  }
+  std::cout << "\n";
+
+  std::cout << "\n ++++++++++ boundary loops  ++++++\n";
+  std::vector<unsigned int> loops = mesh.get_boundary_loops();
+  print_loops(loops);
+
+  std::cout << "\n ++++++++++ split  ++++++\n";
+  std::vector<Mesh> components = mesh.split_components();
+  for (auto &component : components) {
+    std::cout << "vertices : " << component.n_vertices << " , faces "
+              << component.n_faces << "\n";
+    component.print_faces();
+    std::vector<unsigned int> component_loops =
+        component.get_boundary_loops();
+    print_loops(component_loops);
+  }
+
+  return 0;
+}
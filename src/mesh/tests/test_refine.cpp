@@ -0,0 +1,46 @@
+/* test implementation */
+#include "../mesh.hpp"
+#include <iostream>
+#include <vector>
+
+void print_refined(Mesh &mesh, int n_new) {
+  // a conforming closed mesh has no boundary
+  std::vector<unsigned int> loops = mesh.get_boundary_loops();
+  std::cout << "new vertices : " << n_new << " , vertices : "
+            << mesh.n_vertices << " , faces " << mesh.n_faces
+            << " , boundary size " << loops.size() << "\n";
+}
+
+auto main() -> int {
+  std::cout << "\n++++++++ Test refine +++++++\n\n";
+
+  std::cout << "\n ++++++++++ curvature  ++++++\n";
+  Mesh ico = Primitives::icosahedron();
+  std::vector<double> curvature(ico.n_vertices, 0.0);
+  curvature.at(0) = -1.0;
+  int n_new = ico.refine(curvature, 0.5, 0);
+  print_refined(ico, n_new);
+  ico.print_faces();
+
+  std::cout << "\n ++++++++++ edge length  ++++++\n";
+  Mesh cube = Primitives::cube();
+  cube.faces.resize(cube.faces.size() - 6);
+  Mesh open_cube(cube.vertices, cube.faces);
+  n_new = open_cube.refine(std::vector<double>(open_cube.n_vertices, 0.0), 0,
+                           1.2);
+  print_refined(open_cube, n_new);
+  open_cube.print_vertices();
+  open_cube.print_faces();
+
+  std::cout << "\n ++++++++++ torus  ++++++\n";
+  Mesh torus = Primitives::torus(0.5, 0.2, 12);
+  for (int i = 0; i < 3; ++i) {
+    torus.set_one_ring();
+    std::vector<double> kn = torus.get_mean_curvature(torus.one_ring);
+    std::vector<double> k = torus.get_scalar_mean_curvature(kn);
+    n_new = torus.refine(k, 2.5, 0);
+    print_refined(torus, n_new);
+  }
+
+  return 0;
+}
@@ -0,0 +1,69 @@
+/* test implementation */
+#include "../mesh.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+void print_radius_range(Mesh &mesh) {
+  double r_min{0};
+  double r_max{0};
+  for (int i = 0; i < mesh.n_vertices; ++i) {
+    double r = std::sqrt(mesh.vertices.at(i * 3) * mesh.vertices.at(i * 3) +
+                         mesh.vertices.at(i * 3 + 1) *
+                             mesh.vertices.at(i * 3 + 1) +
+                         mesh.vertices.at(i * 3 + 2) *
+                             mesh.vertices.at(i * 3 + 2));
+    r_min = i == 0 ? r : std::min(r, r_min);
+    r_max = i == 0 ? r : std::max(r, r_max);
+  }
+  std::cout << "radius : " << r_min << " , " << r_max << "\n";
+}
+
+void print_face_edges(Mesh &mesh) {
+  for (int i = 0; i < mesh.n_faces; ++i) {
+    std::cout << "face edges " << i << " : ";
+    for (int k = 0; k < 3; ++k) {
+      unsigned int e = mesh.face_edges.at(i * 3 + k);
+      std::cout << mesh.edges.at(e * 2) << "-" << mesh.edges.at(e * 2 + 1)
+                << " , ";
+    }
+    std::cout << "\n";
+  }
+}
+
+auto main() -> int {
+  std::cout << "\n++++++++ Test subdivision +++++++\n\n";
+
+  std::cout << "\n ++++++++++ Loop  ++++++\n";
+  Mesh tet = Primitives::tetrahedron();
+  tet.subdivide(Subdivision::LOOP);
+  tet.print_vertices();
+  tet.print_faces();
+  print_face_edges(tet);
+
+  std::cout << "\n ++++++++++ sqrt(3)  ++++++\n";
+  tet = Primitives::tetrahedron();
+  tet.subdivide(Subdivision::SQRT3);
+  tet.print_vertices();
+  tet.print_faces();
+  print_face_edges(tet);
+
+  std::cout << "\n ++++++++++ open cube  ++++++\n";
+  Mesh cube = Primitives::cube();
+  cube.faces.resize(cube.faces.size() - 6);
+  Mesh open_cube(cube.vertices, cube.faces);
+  open_cube.subdivide(Subdivision::LOOP);
+  open_cube.print_vertices();
+
+  std::cout << "\n ++++++++++ levels  ++++++\n";
+  for (auto scheme :
+       {Subdivision::MIDPOINT, Subdivision::LOOP, Subdivision::SQRT3}) {
+    Mesh ico = Primitives::icosahedron();
+    ico.subdivide(scheme, 3);
+    std::cout << "vertices : " << ico.n_vertices << " , faces "
+              << ico.n_faces << " , edges " << ico.edges.size() / 2 << "\n";
+    print_radius_range(ico);
+  }
+
+  return 0;
+}
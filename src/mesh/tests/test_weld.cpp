@@ -0,0 +1,45 @@
+/* test implementation */
+#include "../mesh.hpp"
+#include <iostream>
+#include <vector>
+
+auto main() -> int {
+  std::cout << "\n++++++++ Test weld +++++++\n\n";
+
+  // Cube as a triangle soup, each face has its own vertices.
+  Mesh cube = Primitives::cube();
+  std::vector<double> soup_vertices(cube.faces.size() * 3);
+  std::vector<unsigned int> soup_faces(cube.faces.size());
+  for (int i = 0; i < (int)cube.faces.size(); ++i) {
+    for (int k = 0; k < 3; ++k) {
+      soup_vertices.at(i * 3 + k) = cube.vertices.at(cube.faces.at(i) * 3 + k);
+    }
+    // small perturbation, smaller than the tolerance
+    soup_vertices.at(i * 3) += (i % 3) * 1e-9;
+    soup_faces.at(i) = i;
+  }
+
+  // adds a degenerate face
+  soup_vertices.insert(soup_vertices.end(), {0.5, 0.5, 0.5, 0.5, 0.5, 0.5,
+                                             0.5, 0.5, 0.5 + 1e-8});
+  soup_faces.insert(soup_faces.end(), {36, 37, 38});
+
+  Mesh soup(soup_vertices, soup_faces);
+  std::cout << "removed vertices : " << soup.weld_vertices(1e-6) << "\n";
+  std::cout << "vertices : " << soup.n_vertices << " , faces "
+            << soup.n_faces << "\n";
+  soup.print_vertices();
+  soup.print_faces();
+
+  std::cout << "\n ++++++++++ one-ring  ++++++\n";
+  soup.set_one_ring();
+  soup.print_one_ring();
+
+  std::cout << "\n ++++++++++ exact  ++++++\n";
+  Mesh exact(soup_vertices, soup_faces);
+  std::cout << "removed vertices : " << exact.weld_vertices(0) << "\n";
+  std::cout << "vertices : " << exact.n_vertices << " , faces "
+            << exact.n_faces << "\n";
+
+  return 0;
+}
@@ -2,28 +2,71 @@
 #include "ply/plyfile.hpp"
 #include "render/colormap.hpp"
 #include "render/trimesh_render.hpp"
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
-auto main(__attribute__((unused)) int argc, char *argv[]) -> int {
+struct PickArgs {
+  /* Arguments for the picking callback, one entry per connected component. */
+  std::vector<Mesh> *components{nullptr};
+  std::vector<std::vector<double>> *curvatures{nullptr};
+  std::vector<int> obj_ids;
+};
 
-  PlyFile file(argv[1]);
+void print_picked_vertex(const PickResult &pick, void *fargs) {
+  /* Prints the curvature of the vertex closest to the cursor. */
+  static long int last_vertex{-1};
+  auto *args = (PickArgs *)fargs;
+  auto obj = std::find(args->obj_ids.begin(), args->obj_ids.end(),
+                       pick.object_id);
+  if (obj == args->obj_ids.end()) {
+    return;
+  }
+  long int component = obj - args->obj_ids.begin();
 
-  Mesh mesh(file.vertices, file.faces);
+  int closest{0};
+  for (int k = 1; k < 3; ++k) {
+    if (pick.barycentric[k] > pick.barycentric[closest]) {
+      closest = k;
+    }
+  }
+  long int vertex =
+      args->components->at(component).faces.at(pick.face * 3 + closest);
+  if (vertex != last_vertex) {
+    std::cout << "component " << component << " , vertex " << vertex
+              << " , curvature : "
+              << args->curvatures->at(component).at(vertex) << "\n";
+    last_vertex = vertex;
+  }
+}
+
+auto main(int argc, char *argv[]) -> int {
+  // meshviewer file.ply [image.png]
+  // with an image name, the mesh is rendered offscreen to this file.
+  bool to_file = argc > 2;
 
-  mesh.set_one_ring();
+  PlyFile file(argv[1]);
 
-  // Takes one_ring as an argument to make explicit that the
-  // method depends on the one-ring.
-  std::vector<double> kn = mesh.get_mean_curvature(mesh.one_ring);
-  std::vector<double> k = mesh.get_scalar_mean_curvature(kn);
+  Mesh mesh(file.vertices, file.faces);
 
-  auto [minvk, maxvk] = std::minmax_element(k.begin(), k.end());
-  double mink = *minvk;
-  double maxk = *maxvk;
+  // Each connected component is rendered as a separate object.
+  std::vector<Mesh> components = mesh.split_components();
+  std::cout << components.size() << " connected components\n";
 
-  std::vector<double> colors =
-      Colormap::get_interpolated_colors(k, Colormap::INFERNO, mink - 0.1, maxk);
+  // The mean curvature of each component is computed from its own
+  // one-ring, the colormap range covers all the components.
+  std::vector<std::vector<double>> curvatures;
+  double mink{0};
+  double maxk{0};
+  for (auto &component : components) {
+    component.set_one_ring();
+    std::vector<double> kn = component.get_mean_curvature(component.one_ring);
+    curvatures.push_back(component.get_scalar_mean_curvature(kn));
+    auto [minvk, maxvk] =
+        std::minmax_element(curvatures.back().begin(), curvatures.back().end());
+    mink = curvatures.size() == 1 ? *minvk : std::min(mink, *minvk);
+    maxk = curvatures.size() == 1 ? *maxvk : std::max(maxk, *maxvk);
+  }
 
   auto [minv, maxv] =
       std::minmax_element(mesh.vertices.begin(), mesh.vertices.end());
@@ -33,11 +76,29 @@ auto main(__attribute__((unused)) int argc, char *argv[]) -> int {
   std::cout << "max " << max << ", min " << min << "\n";
   double extent_vert = *maxv - *minv;
   extent_vert *= 1.2;
-  for (auto &v : mesh.vertices) {
-    v /= extent_vert;
+
+  MeshRender render(500, 500,
+                    to_file ? RenderMode::HEADLESS : RenderMode::WINDOW);
+  PickArgs pick_args{&components, &curvatures, {}};
+  for (unsigned int i = 0; i < components.size(); ++i) {
+    for (auto &v : components[i].vertices) {
+      v /= extent_vert;
+    }
+    // the curvature is mapped to the colors on the GPU
+    pick_args.obj_ids.push_back(
+        render.add_mesh(components[i].vertices, components[i].faces,
+                        curvatures[i], Colormap::INFERNO, mink - 0.1, maxk));
   }
 
-  MeshRender render(500, 500, mesh.vertices, mesh.faces, colors);
+  if (to_file) {
+    render.render_to_file(argv[2]);
+    render.render_finalize();
+    return 0;
+  }
+
+  // right click, or P to toggle hovering, prints the curvature
+  render.set_pick_callback(print_picked_vertex, &pick_args);
+
   render.render_loop(nullptr, nullptr);
   render.render_finalize();
 
@@ -0,0 +1,189 @@
+#ifndef BUFFER_ARENA_H_
+#define BUFFER_ARENA_H_
+#include "glad/include/glad/glad.h"
+#include <algorithm>
+#include <vector>
+
+struct ArenaRange {
+  // Allocation in an arena, in units (a unit is unit_size elements).
+  long int offset{-1};
+  long int length{0};
+};
+
+template <class T> class BufferArena {
+  /* Sub-allocates one openGL buffer between the objects.
+   * A host copy of the buffer is kept, the capacity grows geometrically and
+   * the whole buffer is only uploaded when it grows or is compacted,
+   * otherwise only the modified ranges are uploaded with glBufferSubData.
+   * Released ranges are kept in a free list sorted by offset and merged
+   * with their neighbours. */
+
+  GLenum target{GL_ARRAY_BUFFER};
+  unsigned int buffer{0};
+  long int unit_size{1};      // elements per unit (vertex stride, ...)
+  long int capacity{0};       // units
+  long int end{0};            // units, after the last allocation
+  std::vector<T> data;        // host copy, capacity * unit_size elements
+  std::vector<ArenaRange> free_ranges;
+
+  void grow(long int min_capacity) {
+    long int new_capacity = std::max(capacity * 2, MIN_CAPACITY);
+    while (new_capacity < min_capacity) {
+      new_capacity *= 2;
+    }
+    capacity = new_capacity;
+    data.resize(capacity * unit_size);
+    glBindBuffer(target, buffer);
+    glBufferData(target, (long)(data.size() * sizeof(T)), data.data(),
+                 GL_DYNAMIC_DRAW);
+  }
+
+public:
+  static constexpr long int MIN_CAPACITY{1024};
+
+  void init(GLenum buffer_target, unsigned int buffer_id,
+            long int elements_per_unit) {
+    target = buffer_target;
+    buffer = buffer_id;
+    unit_size = elements_per_unit;
+  }
+
+  auto allocate(long int length) -> long int {
+    /* First fit in the free list, otherwise at the end.
+     * Returns the offset in units. */
+    for (auto range = free_ranges.begin(); range != free_ranges.end();
+         ++range) {
+      if (range->length >= length) {
+        long int offset = range->offset;
+        range->offset += length;
+        range->length -= length;
+        if (range->length == 0) {
+          free_ranges.erase(range);
+        }
+        return offset;
+      }
+    }
+    if (end + length > capacity) {
+      grow(end + length);
+    }
+    end += length;
+    return end - length;
+  }
+
+  void release(long int offset, long int length) {
+    if (length <= 0) {
+      return;
+    }
+    auto next = std::lower_bound(
+        free_ranges.begin(), free_ranges.end(), offset,
+        [](const ArenaRange &r, long int o) { return r.offset < o; });
+    next = free_ranges.insert(next, {offset, length});
+
+    // merges with the following and the preceding free ranges
+    if (next + 1 != free_ranges.end() &&
+        next->offset + next->length == (next + 1)->offset) {
+      next->length += (next + 1)->length;
+      free_ranges.erase(next + 1);
+    }
+    if (next != free_ranges.begin() &&
+        (next - 1)->offset + (next - 1)->length == next->offset) {
+      (next - 1)->length += next->length;
+      next = free_ranges.erase(next) - 1;
+    }
+    // gives back the space at the end
+    if (next->offset + next->length == end) {
+      end = next->offset;
+      free_ranges.erase(next);
+    }
+  }
+
+  auto resize(long int offset, long int length, long int new_length)
+      -> long int {
+    /* Resizes an allocation, in place if the following units are free,
+     * otherwise moves it and copies its content.
+     * Returns the new offset. */
+    if (new_length <= length) {
+      release(offset + new_length, length - new_length);
+      return offset;
+    }
+    long int extra = new_length - length;
+    if (offset + length == end) {
+      if (end + extra > capacity) {
+        grow(end + extra);
+      }
+      end += extra;
+      return offset;
+    }
+    auto next = std::lower_bound(
+        free_ranges.begin(), free_ranges.end(), offset + length,
+        [](const ArenaRange &r, long int o) { return r.offset < o; });
+    if (next != free_ranges.end() && next->offset == offset + length &&
+        next->length >= extra) {
+      next->offset += extra;
+      next->length -= extra;
+      if (next->length == 0) {
+        free_ranges.erase(next);
+      }
+      return offset;
+    }
+
+    long int new_offset = allocate(new_length);
+    std::copy(data.begin() + offset * unit_size,
+              data.begin() + (offset + length) * unit_size,
+              data.begin() + new_offset * unit_size);
+    release(offset, length);
+    return new_offset;
+  }
+
+  void compact(std::vector<ArenaRange> &ranges) {
+    /* Moves the given ranges (all the live allocations) to the beginning of
+     * the buffer, keeping their order, then uploads the used part once.
+     * The offsets are updated in place. */
+    std::vector<ArenaRange *> sorted(ranges.size());
+    for (unsigned long i = 0; i < ranges.size(); ++i) {
+      sorted[i] = &ranges[i];
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const ArenaRange *a, const ArenaRange *b) {
+                return a->offset < b->offset;
+              });
+    end = 0;
+    for (ArenaRange *range : sorted) {
+      // moving to the left, the data before end is already in place
+      if (range->offset != end) {
+        std::copy(data.begin() + range->offset * unit_size,
+                  data.begin() + (range->offset + range->length) * unit_size,
+                  data.begin() + end * unit_size);
+        range->offset = end;
+      }
+      end += range->length;
+    }
+    free_ranges.clear();
+    upload(0, end);
+  }
+
+  void upload(long int offset, long int length) {
+    if (length <= 0) {
+      return;
+    }
+    glBindBuffer(target, buffer);
+    glBufferSubData(target, (long)(offset * unit_size * sizeof(T)),
+                    (long)(length * unit_size * sizeof(T)),
+                    data.data() + offset * unit_size);
+  }
+
+  // host copy of the unit at offset
+  auto host(long int offset) -> T * { return data.data() + offset * unit_size; }
+
+  [[nodiscard]] auto used_size() const -> long int { return end; }
+
+  [[nodiscard]] auto free_size() const -> long int {
+    long int size{0};
+    for (const auto &range : free_ranges) {
+      size += range.length;
+    }
+    return size;
+  }
+};
+
+#endif // BUFFER_ARENA_H_
@@ -0,0 +1,308 @@
+#include "bvh.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+constexpr int LEAF_SIZE{4};
+constexpr int MAX_SPATIAL_SPLIT_DEPTH{64};
+constexpr int STACK_SIZE{128}; // > MAX_SPATIAL_SPLIT_DEPTH + log2(n_faces)
+
+struct BuildFace {
+  float min[3];
+  float max[3];
+  float centroid[3];
+  unsigned int id;
+};
+
+struct BuildTask {
+  int node{0};
+  long int begin{0};
+  long int end{0};
+  int depth{0};
+};
+
+void Bvh::build(const float *vertices, long int stride, long int n_vertices,
+                const unsigned int *indices, long int n_faces) {
+  /* Top-down construction, each node is split in the middle of its largest
+   * centroids extent. */
+
+  nodes.clear();
+  face_ids.resize(n_faces);
+  if (n_faces == 0) {
+    positions.clear();
+    faces.clear();
+    return;
+  }
+
+  positions.resize(n_vertices * 3);
+  for (long int i = 0; i < n_vertices; ++i) {
+    for (long int k = 0; k < 3; ++k) {
+      positions[i * 3 + k] = vertices[i * stride + k];
+    }
+  }
+
+  // faces bounding boxes and centroids, sorted in place during the build
+  std::vector<BuildFace> build_faces(n_faces);
+  for (long int i = 0; i < n_faces; ++i) {
+    build_faces[i].id = (unsigned int)i;
+    for (long int k = 0; k < 3; ++k) {
+      float p0 = positions[indices[i * 3] * 3 + k];
+      float p1 = positions[indices[i * 3 + 1] * 3 + k];
+      float p2 = positions[indices[i * 3 + 2] * 3 + k];
+      build_faces[i].min[k] = std::min({p0, p1, p2});
+      build_faces[i].max[k] = std::max({p0, p1, p2});
+      build_faces[i].centroid[k] = (p0 + p1 + p2) / 3.0F;
+    }
+  }
+
+  // about 2 * n_faces / LEAF_SIZE nodes for a balanced tree
+  nodes.reserve(4 * (n_faces / LEAF_SIZE + 1));
+  nodes.emplace_back();
+  std::vector<BuildTask> tasks{{0, 0, n_faces, 0}};
+
+  float cmin[3];
+  float cmax[3];
+  while (!tasks.empty()) {
+    BuildTask task = tasks.back();
+    tasks.pop_back();
+
+    Node node;
+    for (int k = 0; k < 3; ++k) {
+      node.min[k] = std::numeric_limits<float>::max();
+      node.max[k] = std::numeric_limits<float>::lowest();
+      cmin[k] = std::numeric_limits<float>::max();
+      cmax[k] = std::numeric_limits<float>::lowest();
+    }
+    for (long int i = task.begin; i < task.end; ++i) {
+      const BuildFace &face = build_faces[i];
+      for (int k = 0; k < 3; ++k) {
+        node.min[k] = std::min(node.min[k], face.min[k]);
+        node.max[k] = std::max(node.max[k], face.max[k]);
+        cmin[k] = std::min(cmin[k], face.centroid[k]);
+        cmax[k] = std::max(cmax[k], face.centroid[k]);
+      }
+    }
+
+    int axis{0};
+    for (int k = 1; k < 3; ++k) {
+      if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis]) {
+        axis = k;
+      }
+    }
+
+    if (task.end - task.begin <= LEAF_SIZE || cmax[axis] <= cmin[axis]) {
+      node.first = (int)task.begin;
+      node.count = (int)(task.end - task.begin);
+      nodes[task.node] = node;
+      continue;
+    }
+
+    // Spatial middle split, falls back to the median if one side is empty
+    // or if the tree gets too deep.
+    float split = 0.5F * (cmin[axis] + cmax[axis]);
+    long int mid = task.begin;
+    if (task.depth < MAX_SPATIAL_SPLIT_DEPTH) {
+      mid = std::partition(build_faces.begin() + task.begin,
+                           build_faces.begin() + task.end,
+                           [axis, split](const BuildFace &face) {
+                             return face.centroid[axis] < split;
+                           }) -
+            build_faces.begin();
+    }
+    if (mid == task.begin || mid == task.end) {
+      mid = (task.begin + task.end) / 2;
+      std::nth_element(build_faces.begin() + task.begin,
+                       build_faces.begin() + mid,
+                       build_faces.begin() + task.end,
+                       [axis](const BuildFace &a, const BuildFace &b) {
+                         return a.centroid[axis] < b.centroid[axis];
+                       });
+    }
+
+    node.first = (int)nodes.size();
+    node.count = 0;
+    nodes[task.node] = node;
+    nodes.emplace_back();
+    nodes.emplace_back();
+    tasks.push_back({node.first, task.begin, mid, task.depth + 1});
+    tasks.push_back({node.first + 1, mid, task.end, task.depth + 1});
+  }
+
+  for (long int i = 0; i < n_faces; ++i) {
+    face_ids[i] = build_faces[i].id;
+  }
+
+  faces.resize(n_faces * 3);
+  for (long int i = 0; i < n_faces; ++i) {
+    std::copy(indices + face_ids[i] * 3, indices + face_ids[i] * 3 + 3,
+              faces.begin() + i * 3);
+  }
+}
+
+auto Bvh::refit(const float *vertices, long int stride, long int n_vertices)
+    -> bool {
+  /* The children are stored after their parent, the nodes are updated from
+   * the last one so that the children are done before their parent. The
+   * tree quality degrades if the vertices move a lot relatively to each
+   * other, the faces of a node then spread out. */
+  if (n_vertices * 3 != (long int)positions.size()) {
+    return false;
+  }
+  for (long int i = 0; i < n_vertices; ++i) {
+    for (long int k = 0; k < 3; ++k) {
+      positions[i * 3 + k] = vertices[i * stride + k];
+    }
+  }
+  for (auto node = nodes.rbegin(); node != nodes.rend(); ++node) {
+    if (node->count == 0) {
+      const Node &left = nodes[node->first];
+      const Node &right = nodes[node->first + 1];
+      for (int k = 0; k < 3; ++k) {
+        node->min[k] = std::min(left.min[k], right.min[k]);
+        node->max[k] = std::max(left.max[k], right.max[k]);
+      }
+      continue;
+    }
+    for (int k = 0; k < 3; ++k) {
+      node->min[k] = std::numeric_limits<float>::max();
+      node->max[k] = std::numeric_limits<float>::lowest();
+    }
+    for (long int i = node->first * 3; i < (node->first + node->count) * 3;
+         ++i) {
+      const float *p = &positions[faces[i] * 3];
+      for (int k = 0; k < 3; ++k) {
+        node->min[k] = std::min(node->min[k], p[k]);
+        node->max[k] = std::max(node->max[k], p[k]);
+      }
+    }
+  }
+  return true;
+}
+
+static auto intersect_box(const float *min, const float *max,
+                          const double *origin, const double *inv_direction,
+                          double t_min, double t_max) -> double {
+  /* Slab test, returns the entry parameter or infinity if missed. */
+  for (int k = 0; k < 3; ++k) {
+    double t0 = (min[k] - origin[k]) * inv_direction[k];
+    double t1 = (max[k] - origin[k]) * inv_direction[k];
+    if (t0 > t1) {
+      std::swap(t0, t1);
+    }
+    t_min = t0 > t_min ? t0 : t_min;
+    t_max = t1 < t_max ? t1 : t_max;
+    if (t_max < t_min) {
+      return std::numeric_limits<double>::infinity();
+    }
+  }
+  return t_min;
+}
+
+static auto intersect_triangle(const float *p0, const float *p1,
+                               const float *p2, const double *origin,
+                               const double *direction, double &t, double &u,
+                               double &v) -> bool {
+  /* Möller–Trumbore ray-triangle intersection, both faces are hit. */
+  double e1[3];
+  double e2[3];
+  double s[3];
+  for (int k = 0; k < 3; ++k) {
+    e1[k] = p1[k] - p0[k];
+    e2[k] = p2[k] - p0[k];
+    s[k] = origin[k] - p0[k];
+  }
+  double p[] = {direction[1] * e2[2] - direction[2] * e2[1],
+                direction[2] * e2[0] - direction[0] * e2[2],
+                direction[0] * e2[1] - direction[1] * e2[0]};
+  double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+  if (std::abs(det) < 1e-14) {
+    return false;
+  }
+  double inv_det = 1.0 / det;
+  u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+  if (u < 0.0 || u > 1.0) {
+    return false;
+  }
+  double q[] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2],
+                s[0] * e1[1] - s[1] * e1[0]};
+  v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) *
+      inv_det;
+  if (v < 0.0 || u + v > 1.0) {
+    return false;
+  }
+  t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+  return true;
+}
+
+auto Bvh::intersect(const double *origin, const double *direction,
+                    double t_min, double t_max, RayHit &hit) const -> bool {
+  /* Finds the closest intersection with t in [t_min, t_max].
+   * hit is only modified if an intersection is found. */
+  if (nodes.empty()) {
+    return false;
+  }
+
+  double inv_direction[3];
+  for (int k = 0; k < 3; ++k) {
+    inv_direction[k] = 1.0 / direction[k];
+  }
+
+  bool found{false};
+  double t{0};
+  double u{0};
+  double v{0};
+  int stack[STACK_SIZE];
+  int stack_size{0};
+
+  if (intersect_box(nodes[0].min, nodes[0].max, origin, inv_direction, t_min,
+                    t_max) < std::numeric_limits<double>::infinity()) {
+    stack[stack_size++] = 0;
+  }
+
+  while (stack_size > 0) {
+    const Node &node = nodes[stack[--stack_size]];
+
+    if (node.count > 0) {
+      for (int i = node.first; i < node.first + node.count; ++i) {
+        if (intersect_triangle(&positions[faces[i * 3] * 3],
+                               &positions[faces[i * 3 + 1] * 3],
+                               &positions[faces[i * 3 + 2] * 3], origin,
+                               direction, t, u, v) &&
+            t >= t_min && t <= t_max) {
+          t_max = t;
+          hit.face = face_ids[i];
+          hit.u = u;
+          hit.v = v;
+          hit.t = t;
+          found = true;
+        }
+      }
+      continue;
+    }
+
+    const Node &left = nodes[node.first];
+    const Node &right = nodes[node.first + 1];
+    double t_left = intersect_box(left.min, left.max, origin, inv_direction,
+                                  t_min, t_max);
+    double t_right = intersect_box(right.min, right.max, origin,
+                                   inv_direction, t_min, t_max);
+
+    // the closest child is pushed last to be visited first
+    if (t_left > t_right) {
+      std::swap(t_left, t_right);
+      if (t_left < std::numeric_limits<double>::infinity()) {
+        if (t_right < std::numeric_limits<double>::infinity()) {
+          stack[stack_size++] = node.first;
+        }
+        stack[stack_size++] = node.first + 1;
+      }
+    } else if (t_left < std::numeric_limits<double>::infinity()) {
+      if (t_right < std::numeric_limits<double>::infinity()) {
+        stack[stack_size++] = node.first + 1;
+      }
+      stack[stack_size++] = node.first;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,49 @@
+#ifndef BVH_H_
+#define BVH_H_
+#include <vector>
+
+struct RayHit {
+  /* Closest intersection of a ray with a triangle soup. */
+  long int face{-1}; // face index in the indices given to the build
+  double u{0}, v{0}; // barycentric coordinates of vertices 1 and 2
+  double t{-1};      // ray parameter at the intersection
+};
+
+class Bvh {
+  /* Bounding volume hierarchy over the triangles of one object,
+   * used for CPU ray picking.
+   * The positions and faces are copied, faces are reordered to follow
+   * the leaves order, so a query only touches contiguous memory. */
+
+  struct Node {
+    float min[3]{0, 0, 0};
+    float max[3]{0, 0, 0};
+    // leaf : index of the first face, inner node : index of the left child
+    // (the right child is left + 1)
+    int first{0};
+    int count{0}; // number of faces in the leaf, 0 for inner nodes
+  };
+
+  std::vector<Node> nodes;
+  std::vector<float> positions;
+  std::vector<unsigned int> faces;    // reordered faces vertices
+  std::vector<unsigned int> face_ids; // reordered index -> original index
+
+public:
+  // positions: x, y, z of each vertex separated by stride floats
+  void build(const float *vertices, long int stride, long int n_vertices,
+             const unsigned int *indices, long int n_faces);
+
+  // Updates the bounds for new positions of the same vertices, the tree
+  // and the faces are kept. Returns false, without changes, if the number
+  // of vertices differs, a build is then needed.
+  auto refit(const float *vertices, long int stride, long int n_vertices)
+      -> bool;
+
+  auto intersect(const double *origin, const double *direction, double t_min,
+                 double t_max, RayHit &hit) const -> bool;
+
+  [[nodiscard]] auto empty() const -> bool { return nodes.empty(); }
+};
+
+#endif // BVH_H_
@@ -1,14 +1,17 @@
 #include "compile_shader.hpp"
 #include "glad/include/glad/glad.h"
 #include <GLFW/glfw3.h>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <string>
 #include <vector>
 
-auto compile_shader(std::string source_fname, GLenum type) -> int {
-
+auto read_source(const std::string &source_fname) -> std::string {
   std::ifstream file;
 
   file.open(source_fname, std::ios::binary | std::ios::in);
@@ -20,11 +23,15 @@ auto compile_shader(std::string source_fname, GLenum type) -> int {
   std::ostringstream contents;
   contents << file.rdbuf();
   file.close();
+  return contents.str();
+}
+
+auto compile_shader(const std::string &source, const std::string &source_fname,
+                    GLenum type) -> int {
 
   int success{0};
   int v_shader{0};
 
-  const std::string source = contents.str();
   const char *s = source.c_str();
 
   // Compile shaders
@@ -52,6 +59,9 @@ auto link_shaders(std::vector<int> &shaders) -> int {
     glAttachShader(shader_program, shader);
   }
 
+  // the binary is saved in the cache after linking
+  glProgramParameteri(shader_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                      GL_TRUE);
   glLinkProgram(shader_program);
   glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
   if (!success) {
@@ -60,11 +70,103 @@ auto link_shaders(std::vector<int> &shaders) -> int {
     std::cout << infoLog.data() << "\n";
   }
   for (auto &shader : shaders) {
+    glDetachShader(shader_program, shader);
     glDeleteShader(shader);
   }
   return shader_program;
 }
 
+auto program_binary_supported() -> bool {
+  int n_formats{0};
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+  return n_formats > 0;
+}
+
+auto cache_key(const std::vector<std::string> &sources) -> uint64_t {
+  /* FNV-1a hash of the sources and of the driver identification, a binary
+   * is only valid for the driver which produced it. */
+  uint64_t hash{0xcbf29ce484222325ULL};
+  auto add = [&hash](const char *data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      hash ^= (unsigned char)data[i];
+      hash *= 0x100000001b3ULL;
+    }
+    hash ^= 0xFF; // separator
+    hash *= 0x100000001b3ULL;
+  };
+  for (const auto &source : sources) {
+    add(source.data(), source.size());
+  }
+  for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    const char *driver = (const char *)glGetString(name);
+    if (driver != nullptr) {
+      add(driver, std::strlen(driver));
+    }
+  }
+  return hash;
+}
+
+auto cache_fname(ShaderProgramType type, uint64_t key) -> std::string {
+  std::ostringstream fname;
+  fname << SHADER_CACHE_DIR << (int)type << "_" << std::hex << key << ".bin";
+  return fname.str();
+}
+
+auto load_program_binary(const std::string &fname) -> int {
+  /* Returns 0 if there is no valid binary. */
+  std::ifstream file(fname, std::ios::binary | std::ios::in);
+  if (file.fail()) {
+    return 0;
+  }
+  GLenum format{0};
+  file.read((char *)&format, sizeof(format));
+  std::vector<char> binary((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+  if (file.bad() || binary.empty()) {
+    return 0;
+  }
+
+  int program = glCreateProgram();
+  glProgramBinary(program, format, binary.data(), (int)binary.size());
+  int success{0};
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void save_program_binary(int program, ShaderProgramType type,
+                         const std::string &fname) {
+  /* Replaces the binaries of older sources or drivers. */
+  int length{0};
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(length);
+  GLenum format{0};
+  glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+  std::error_code error;
+  std::filesystem::create_directories(SHADER_CACHE_DIR, error);
+  if (error) {
+    return;
+  }
+  std::string prefix = std::to_string((int)type) + "_";
+  for (const auto &entry :
+       std::filesystem::directory_iterator(SHADER_CACHE_DIR, error)) {
+    if (entry.path().filename().string().rfind(prefix, 0) == 0) {
+      std::filesystem::remove(entry.path(), error);
+    }
+  }
+
+  std::ofstream file(fname, std::ios::binary | std::ios::out);
+  file.write((const char *)&format, sizeof(format));
+  file.write(binary.data(), length);
+}
+
 auto create_program(ShaderProgramType type) -> int {
 
   // map to keep track of the currently available programs;
@@ -76,26 +178,51 @@ auto create_program(ShaderProgramType type) -> int {
     return compiled_shader_programs_map.at(type);
   }
 
-  std::vector<int> shader_id;
-
-  shader_id.push_back(compile_shader(
-      SHADER_DIR_MAP.at(type) + "vertex_shader.glsl", GL_VERTEX_SHADER));
-
-  shader_id.push_back(compile_shader(
-      SHADER_DIR_MAP.at(type) + "fragment_shader.glsl", GL_FRAGMENT_SHADER));
+  std::vector<std::string> fnames{
+      SHADER_DIR_MAP.at(type) + "vertex_shader.glsl",
+      SHADER_DIR_MAP.at(type) + "fragment_shader.glsl"};
+  std::vector<GLenum> stages{GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
 
   switch (type) {
   case ShaderProgramType::TUBE_CURVE:
   case ShaderProgramType::QUAD_CURVE:
   case ShaderProgramType::SMOOTH_TUBE_CURVE:
-    shader_id.push_back(compile_shader(
-        SHADER_DIR_MAP.at(type) + "geometry_shader.glsl", GL_GEOMETRY_SHADER));
+    fnames.push_back(SHADER_DIR_MAP.at(type) + "geometry_shader.glsl");
+    stages.push_back(GL_GEOMETRY_SHADER);
     break;
   default:
     break;
   }
 
-  compiled_shader_programs_map[type] = link_shaders(shader_id);
+  std::vector<std::string> sources;
+  for (const auto &fname : fnames) {
+    sources.push_back(read_source(fname));
+  }
+
+  // Reuses the binary of a previous run if the sources and driver match.
+  bool use_cache = program_binary_supported();
+  std::string binary_fname;
+  if (use_cache) {
+    binary_fname = cache_fname(type, cache_key(sources));
+    int program = load_program_binary(binary_fname);
+    if (program != 0) {
+      compiled_shader_programs_map[type] = program;
+      return program;
+    }
+  }
+
+  std::vector<int> shader_id;
+  for (int i = 0; i < (int)sources.size(); ++i) {
+    shader_id.push_back(compile_shader(sources[i], fnames[i], stages[i]));
+  }
+
+  int program = link_shaders(shader_id);
+  int success{0};
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (use_cache && success) {
+    save_program_binary(program, type, binary_fname);
+  }
+  compiled_shader_programs_map[type] = program;
 
   return compiled_shader_programs_map[type];
 }
@@ -13,6 +13,7 @@ enum class ShaderProgramType : int {
   TUBE_CURVE,
   SMOOTH_TUBE_CURVE,
   AXIS_CROSS,
+  TEXT_OVERLAY,
 };
 
 // Contains the list of sources directory names for each shader type;
@@ -23,7 +24,12 @@ std::map<ShaderProgramType, std::string> const SHADER_DIR_MAP{
     {ShaderProgramType::VECTOR_INSTANCE, "shaders/vector_instance/"},
     {ShaderProgramType::QUAD_CURVE, "shaders/quad_curve/"},
     {ShaderProgramType::SMOOTH_TUBE_CURVE, "shaders/smooth_tube_curve/"},
-    {ShaderProgramType::TUBE_CURVE, "shaders/tube_curve/"}};
+    {ShaderProgramType::TUBE_CURVE, "shaders/tube_curve/"},
+    {ShaderProgramType::TEXT_OVERLAY, "shaders/text_overlay/"}};
+
+// Linked programs binaries are stored in this directory, relative to the
+// working directory like the sources.
+const std::string SHADER_CACHE_DIR{".shader_cache/"};
 
 auto create_program(ShaderProgramType type) -> int;
 
@@ -0,0 +1,213 @@
+#include "frame_capture.hpp"
+#include "glad/include/glad/glad.h"
+#include "image_file.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr uint64_t FENCE_TIMEOUT{1000000000}; // ns
+
+static void check_pattern(const std::string &pattern) {
+  /* The pattern is given to snprintf with the frame number, it should have
+   * exactly one int conversion (d or i, with flags, width and precision),
+   * %% writes a %. */
+  int n_conversions{0};
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] != '%') {
+      continue;
+    }
+    ++i;
+    if (i < pattern.size() && pattern[i] == '%') {
+      continue;
+    }
+    i = std::min(pattern.find_first_not_of("-+ #0", i), pattern.size());
+    i = std::min(pattern.find_first_not_of("0123456789", i), pattern.size());
+    if (i < pattern.size() && pattern[i] == '.') {
+      i = std::min(pattern.find_first_not_of("0123456789", i + 1),
+                   pattern.size());
+    }
+    if (i == pattern.size() || (pattern[i] != 'd' && pattern[i] != 'i')) {
+      throw std::invalid_argument("Only int conversions (e.g. %05d) are "
+                                  "allowed in the pattern in " +
+                                  std::string(__func__) + "\n");
+    }
+    ++n_conversions;
+  }
+  if (n_conversions != 1) {
+    throw std::invalid_argument("The pattern needs one conversion for the "
+                                "frame number in " +
+                                std::string(__func__) + "\n");
+  }
+}
+
+void FrameCapture::start(const std::string &fname_pattern) {
+  check_pattern(fname_pattern);
+  stop();
+  pattern = fname_pattern;
+  n_frames = 0;
+  stopping = false;
+  worker = std::thread(&FrameCapture::work, this);
+  capturing = true;
+}
+
+void FrameCapture::stop() {
+  if (!capturing) {
+    return;
+  }
+  retrieve_all();
+  release();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  jobs_changed.notify_all();
+  worker.join();
+  capturing = false;
+}
+
+void FrameCapture::allocate(int frame_width, int frame_height) {
+  width = frame_width;
+  height = frame_height;
+  for (Slot &slot : slots) {
+    glGenBuffers(1, &slot.pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (long)width * height * 4, nullptr,
+                 GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameCapture::release() {
+  for (Slot &slot : slots) {
+    if (slot.fence != nullptr) {
+      glDeleteSync(slot.fence);
+    }
+    if (slot.pbo != 0) {
+      glDeleteBuffers(1, &slot.pbo);
+    }
+    slot = Slot();
+  }
+  width = 0;
+  height = 0;
+}
+
+void FrameCapture::capture(int frame_width, int frame_height) {
+  if (frame_width != width || frame_height != height) {
+    // the window was resized
+    retrieve_all();
+    release();
+    allocate(frame_width, frame_height);
+  }
+
+  Slot &slot = slots[n_frames % N_PBOS];
+  if (slot.frame >= 0) {
+    retrieve(slot);
+  }
+
+  // RGBA is the framebuffer format, the transfer needs no conversion
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.frame = n_frames++;
+}
+
+void FrameCapture::retrieve_all() {
+  // the next slot to be written holds the oldest frame
+  for (int k = 0; k < N_PBOS; ++k) {
+    Slot &slot = slots[(n_frames + k) % N_PBOS];
+    if (slot.frame >= 0) {
+      retrieve(slot);
+    }
+  }
+}
+
+void FrameCapture::retrieve(Slot &slot) {
+  /* Copies the pixels of a slot to a job for the worker. The fence is
+   * normally already signaled, the frame was read N_PBOS frames ago. */
+  GLenum status{GL_TIMEOUT_EXPIRED};
+  while (status == GL_TIMEOUT_EXPIRED) {
+    status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              FENCE_TIMEOUT);
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = nullptr;
+
+  Job job{slot.frame, width, height, {}};
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!free_buffers.empty()) {
+      job.rgba = std::move(free_buffers.back());
+      free_buffers.pop_back();
+    }
+  }
+  long int size = (long)width * height * 4;
+  job.rgba.resize(size);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  const auto *pixels = (const unsigned char *)glMapBufferRange(
+      GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+  if (pixels != nullptr) {
+    std::copy(pixels, pixels + size, job.rgba.begin());
+  }
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.frame = -1;
+
+  // waits if the worker is too late, to bound the memory used
+  std::unique_lock<std::mutex> lock(mutex);
+  jobs_changed.wait(lock, [this]() { return jobs.size() < MAX_JOBS; });
+  jobs.push_back(std::move(job));
+  lock.unlock();
+  jobs_changed.notify_all();
+}
+
+void FrameCapture::work() {
+  /* Worker thread, flips the rows, drops the alpha channel and writes the
+   * image files. */
+  std::vector<unsigned char> rgb;
+  std::vector<char> fname;
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs_changed.wait(lock, [this]() { return !jobs.empty() || stopping; });
+    if (jobs.empty()) {
+      break;
+    }
+    Job job = std::move(jobs.front());
+    jobs.pop_front();
+    lock.unlock();
+    jobs_changed.notify_all();
+
+    rgb.resize((long)job.width * job.height * 3);
+    for (long int y = 0; y < job.height; ++y) {
+      const unsigned char *src =
+          job.rgba.data() + (job.height - 1 - y) * job.width * 4;
+      unsigned char *dst = rgb.data() + y * job.width * 3;
+      for (long int x = 0; x < job.width; ++x) {
+        dst[x * 3] = src[x * 4];
+        dst[x * 3 + 1] = src[x * 4 + 1];
+        dst[x * 3 + 2] = src[x * 4 + 2];
+      }
+    }
+
+    // the width of the conversion is not bounded
+    fname.resize(
+        std::snprintf(nullptr, 0, pattern.c_str(), (int)job.frame) + 1);
+    std::snprintf(fname.data(), fname.size(), pattern.c_str(), (int)job.frame);
+    try {
+      ImageFile::write(fname.data(), job.width, job.height, rgb);
+    } catch (const std::exception &error) {
+      std::cout << "Error, frame " << job.frame << " not captured : "
+                << error.what();
+    }
+
+    lock.lock();
+    free_buffers.push_back(std::move(job.rgba));
+  }
+}
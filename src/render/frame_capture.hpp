@@ -0,0 +1,67 @@
+#ifndef FRAME_CAPTURE_H_
+#define FRAME_CAPTURE_H_
+#include "glad/include/glad/glad.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameCapture {
+  /* Asynchronous readback of the rendered frames.
+   * Each frame is read in a ring of pixel buffer objects, glReadPixels
+   * returns without waiting for the GPU. A buffer is mapped N_PBOS frames
+   * later, when its transfer is done, and the pixels are handed to a worker
+   * thread which converts and writes the image file, so that frame N is
+   * written while frame N + 2 is drawn. */
+public:
+  static constexpr int N_PBOS{3};
+
+  // fname_pattern is a printf format taking the frame number as an int,
+  // e.g. "frames/%05d.png". Throws std::invalid_argument unless it has
+  // exactly one d or i conversion.
+  void start(const std::string &fname_pattern);
+  // Writes the frames not yet retrieved and waits for the worker.
+  void stop();
+  [[nodiscard]] auto active() const -> bool { return capturing; }
+
+  // Reads the current read framebuffer, to be called before the swap.
+  void capture(int frame_width, int frame_height);
+
+private:
+  struct Slot {
+    unsigned int pbo{0};
+    GLsync fence{nullptr};
+    long int frame{-1}; // -1 if empty
+  };
+
+  struct Job {
+    long int frame{0};
+    int width{0}, height{0};
+    std::vector<unsigned char> rgba; // rows from bottom to top
+  };
+
+  bool capturing{false};
+  std::string pattern;
+  Slot slots[N_PBOS];
+  int width{0}, height{0};
+  long int n_frames{0};
+
+  // jobs waiting for the worker, and buffers reused between jobs
+  static constexpr unsigned long MAX_JOBS{8};
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable jobs_changed;
+  std::deque<Job> jobs;
+  std::vector<std::vector<unsigned char>> free_buffers;
+  bool stopping{false};
+
+  void allocate(int frame_width, int frame_height);
+  void release();
+  void retrieve(Slot &slot);
+  void retrieve_all();
+  void work();
+};
+
+#endif // FRAME_CAPTURE_H_
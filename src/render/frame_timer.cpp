@@ -0,0 +1,189 @@
+#include "frame_timer.hpp"
+#include "glad/include/glad/glad.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+void FrameTimer::start(bool time_objects) {
+  stop();
+  timing = true;
+  per_object = time_objects;
+}
+
+void FrameTimer::stop() {
+  if (!timing) {
+    return;
+  }
+  if (gpu_phase || object_running) {
+    glEndQuery(GL_TIME_ELAPSED);
+  }
+  for (QuerySet &set : sets) {
+    if (!set.queries.empty()) {
+      glDeleteQueries((int)set.queries.size(), set.queries.data());
+    }
+    set = QuerySet();
+  }
+  for (int i = 0; i < N_FRAME_PHASES; ++i) {
+    cpu[i] = Rolling();
+    gpu[i] = Rolling();
+    cpu_frame[i] = 0;
+  }
+  objects_gpu.clear();
+  gpu_phase = false;
+  object_running = false;
+  frame_started = false;
+  timing = false;
+}
+
+auto FrameTimer::begin_query(int key) -> bool {
+  // the queries are created when a frame needs more than the previous ones
+  QuerySet &set = sets[current];
+  if (set.n_used == MAX_QUERIES) {
+    return false;
+  }
+  if (set.n_used == (int)set.queries.size()) {
+    unsigned int query{0};
+    glGenQueries(1, &query);
+    set.queries.push_back(query);
+    set.keys.push_back(key);
+  }
+  set.keys[set.n_used] = key;
+  glBeginQuery(GL_TIME_ELAPSED, set.queries[set.n_used]);
+  ++set.n_used;
+  return true;
+}
+
+void FrameTimer::begin(FramePhase phase) {
+  if (!timing) {
+    return;
+  }
+  auto index = (int)phase;
+  phase_start[index] = Clock::now();
+  // the objects queries measure the draws
+  if (phase != FramePhase::DRAW || !per_object) {
+    gpu_phase = begin_query(index);
+  }
+}
+
+void FrameTimer::end(FramePhase phase) {
+  if (!timing) {
+    return;
+  }
+  if (gpu_phase) {
+    glEndQuery(GL_TIME_ELAPSED);
+    gpu_phase = false;
+  }
+  auto index = (int)phase;
+  std::chrono::duration<double, std::milli> duration =
+      Clock::now() - phase_start[index];
+  cpu_frame[index] += duration.count();
+}
+
+void FrameTimer::begin_object(int id) {
+  if (!timing || !per_object) {
+    return;
+  }
+  object_running = begin_query(N_FRAME_PHASES + id);
+}
+
+void FrameTimer::end_object() {
+  if (object_running) {
+    glEndQuery(GL_TIME_ELAPSED);
+    object_running = false;
+  }
+}
+
+void FrameTimer::read_queries(QuerySet &set) {
+  /* Adds the durations of a frame, the results are available unless the
+   * GPU is more than one frame late. */
+  if (set.n_used == 0) {
+    return;
+  }
+  double gpu_frame[N_FRAME_PHASES]{};
+  std::map<int, double> objects_frame;
+  for (int i = 0; i < set.n_used; ++i) {
+    uint64_t elapsed{0}; // ns
+    glGetQueryObjectui64v(set.queries[i], GL_QUERY_RESULT, &elapsed);
+    double ms = (double)elapsed * 1e-6;
+    int key = set.keys[i];
+    if (key < N_FRAME_PHASES) {
+      gpu_frame[key] += ms;
+    } else {
+      objects_frame[key - N_FRAME_PHASES] += ms;
+      gpu_frame[(int)FramePhase::DRAW] += ms;
+    }
+    gpu_frame[(int)FramePhase::FRAME] += ms;
+  }
+  for (int i = 0; i < N_FRAME_PHASES; ++i) {
+    gpu[i].add(gpu_frame[i]);
+  }
+  for (const auto &[id, ms] : objects_frame) {
+    objects_gpu[id].add(ms);
+  }
+  set.n_used = 0;
+}
+
+void FrameTimer::end_frame() {
+  if (!timing) {
+    return;
+  }
+  Clock::time_point now = Clock::now();
+  if (frame_started) {
+    std::chrono::duration<double, std::milli> duration = now - frame_start;
+    cpu_frame[(int)FramePhase::FRAME] = duration.count();
+    for (int i = 0; i < N_FRAME_PHASES; ++i) {
+      cpu[i].add(cpu_frame[i]);
+    }
+  }
+  std::fill(cpu_frame, cpu_frame + N_FRAME_PHASES, 0.0);
+  frame_start = now;
+  frame_started = true;
+
+  current = 1 - current;
+  read_queries(sets[current]);
+}
+
+auto FrameTimer::phase_timings(FramePhase phase) const -> PhaseTimings {
+  return {cpu[(int)phase].stats(), gpu[(int)phase].stats()};
+}
+
+auto FrameTimer::object_timings(int id) const -> TimingStats {
+  auto found = objects_gpu.find(id);
+  if (found == objects_gpu.end()) {
+    return {};
+  }
+  return found->second.stats();
+}
+
+auto FrameTimer::timed_objects() const -> std::vector<int> {
+  std::vector<int> ids;
+  for (const auto &object : objects_gpu) {
+    ids.push_back(object.first);
+  }
+  return ids;
+}
+
+void FrameTimer::Rolling::add(double value) {
+  if ((int)samples.size() < WINDOW) {
+    samples.push_back(value);
+    return;
+  }
+  samples[next] = value;
+  next = (next + 1) % WINDOW;
+}
+
+auto FrameTimer::Rolling::stats() const -> TimingStats {
+  TimingStats stats;
+  if (samples.empty()) {
+    return stats;
+  }
+  stats.n_samples = (int)samples.size();
+  stats.min = *std::min_element(samples.begin(), samples.end());
+  stats.max = *std::max_element(samples.begin(), samples.end());
+  for (double sample : samples) {
+    stats.mean += sample;
+  }
+  stats.mean /= stats.n_samples;
+  return stats;
+}
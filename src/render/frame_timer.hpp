@@ -0,0 +1,106 @@
+#ifndef FRAME_TIMER_H_
+#define FRAME_TIMER_H_
+#include <chrono>
+#include <map>
+#include <vector>
+
+enum class FramePhase : int {
+  UPDATE,  // data update function, or frame of the simulation applied
+  UPLOAD,  // camera, draw commands and culling
+  DRAW,    // draw calls, on the GPU the sum of the objects if timed
+  CAPTURE, // frame readback
+  FRAME,   // CPU time between two frames, GPU time of all the phases
+};
+constexpr int N_FRAME_PHASES{5};
+
+struct TimingStats {
+  // Milliseconds, over the last FrameTimer::WINDOW samples.
+  double mean{0};
+  double min{0};
+  double max{0};
+  int n_samples{0};
+};
+
+struct PhaseTimings {
+  TimingStats cpu;
+  TimingStats gpu;
+};
+
+class FrameTimer {
+  /* CPU and GPU durations of the phases of the frames, and GPU draw time of
+   * each object.
+   * The CPU durations are measured with the steady clock, the GPU durations
+   * with GL_TIME_ELAPSED queries, recorded in two sets used on alternate
+   * frames: the queries of a frame are read when the set is reused, one
+   * frame later, when the GPU is done with them. The GPU statistics lag one
+   * frame behind the CPU ones. */
+public:
+  static constexpr int WINDOW{120};
+  // queries per frame, beyond the GPU durations are not measured (e.g. the
+  // update function of an idle render loop, called without drawing)
+  static constexpr int MAX_QUERIES{1024};
+
+  // per_object splits the draws to time each object, which defeats the
+  // batching of the draw calls.
+  void start(bool per_object);
+  void stop();
+  [[nodiscard]] auto active() const -> bool { return timing; }
+  [[nodiscard]] auto timing_objects() const -> bool { return per_object; }
+
+  // A phase can be entered several times per frame, the durations are
+  // added. The GPU queries can't be nested.
+  void begin(FramePhase phase);
+  void end(FramePhase phase);
+  // GPU draw time of an object, inside the DRAW phase.
+  void begin_object(int id);
+  void end_object();
+  // Reads the queries of the previous frame and starts the next one.
+  void end_frame();
+
+  [[nodiscard]] auto phase_timings(FramePhase phase) const -> PhaseTimings;
+  [[nodiscard]] auto object_timings(int id) const -> TimingStats;
+  // ids of the objects which have GPU timings
+  [[nodiscard]] auto timed_objects() const -> std::vector<int>;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  class Rolling {
+    // Last WINDOW samples, in a ring.
+  public:
+    void add(double value);
+    [[nodiscard]] auto stats() const -> TimingStats;
+
+  private:
+    std::vector<double> samples;
+    int next{0};
+  };
+
+  struct QuerySet {
+    // Queries of one frame, the key is the phase or N_FRAME_PHASES + id.
+    std::vector<unsigned int> queries;
+    std::vector<int> keys;
+    int n_used{0};
+  };
+
+  bool timing{false};
+  bool per_object{false};
+  QuerySet sets[2];
+  int current{0};
+  bool gpu_phase{false}; // a phase query is running
+  bool object_running{false};
+
+  Clock::time_point phase_start[N_FRAME_PHASES];
+  Clock::time_point frame_start;
+  bool frame_started{false};
+  double cpu_frame[N_FRAME_PHASES]{};
+
+  Rolling cpu[N_FRAME_PHASES];
+  Rolling gpu[N_FRAME_PHASES];
+  std::map<int, Rolling> objects_gpu;
+
+  auto begin_query(int key) -> bool;
+  void read_queries(QuerySet &set);
+};
+
+#endif // FRAME_TIMER_H_
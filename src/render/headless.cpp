@@ -0,0 +1,228 @@
+#include "glad/include/glad/glad.h"
+#include "image_file.hpp"
+#include "trimesh_render.hpp"
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+auto glCheckError_(const char *file, int line) -> GLenum;
+#define glCheckError() glCheckError_(__FILE__, __LINE__)
+
+constexpr int OFFSCREEN_SAMPLES{4}; // anti-aliasing
+
+static auto get_egl_display() -> EGLDisplay {
+  /* Prefers the Mesa surfaceless platform, which needs neither a display
+   * server nor a GPU (llvmpipe). */
+  const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  auto get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  if (extensions != nullptr && get_platform_display != nullptr &&
+      std::strstr(extensions, "EGL_MESA_platform_surfaceless") != nullptr) {
+    EGLDisplay display = get_platform_display(
+        EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display != EGL_NO_DISPLAY) {
+      return display;
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+void MeshRender::init_headless() {
+  /* Creates an openGL core context without surface, the frames are drawn
+   * in a multisampled framebuffer object. */
+  EGLDisplay display = get_egl_display();
+  EGLint major{0};
+  EGLint minor{0};
+  if (display == EGL_NO_DISPLAY ||
+      eglInitialize(display, &major, &minor) == EGL_FALSE) {
+    std::cout << "Error, failed to initialize EGL\n";
+    exit(1);
+  }
+  eglBindAPI(EGL_OPENGL_API);
+
+  const EGLint config_attribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                   EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                   EGL_NONE};
+  EGLConfig config{nullptr};
+  EGLint n_configs{0};
+  eglChooseConfig(display, config_attribs, &config, 1, &n_configs);
+  if (n_configs == 0) {
+    config = nullptr; // EGL_KHR_no_config_context
+  }
+
+  // the most recent core version available, the shaders need 4.x
+  const EGLint versions[][2] = {{4, 6}, {4, 5}, {4, 4}, {4, 3}, {3, 3}};
+  EGLContext context{EGL_NO_CONTEXT};
+  for (const auto &version : versions) {
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION,
+        version[0],
+        EGL_CONTEXT_MINOR_VERSION,
+        version[1],
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    context =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (context != EGL_NO_CONTEXT) {
+      break;
+    }
+  }
+  if (context == EGL_NO_CONTEXT) {
+    std::cout << "Error, failed to create an EGL openGL context\n";
+    exit(1);
+  }
+
+  // without EGL_KHR_surfaceless_context, a small pbuffer is used
+  if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context) ==
+      EGL_FALSE) {
+    const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    EGLSurface surface =
+        config != nullptr
+            ? eglCreatePbufferSurface(display, config, pbuffer_attribs)
+            : EGL_NO_SURFACE;
+    if (surface == EGL_NO_SURFACE ||
+        eglMakeCurrent(display, surface, surface, context) == EGL_FALSE) {
+      std::cout << "Error, failed to make the EGL context current\n";
+      exit(1);
+    }
+  }
+  egl_display = display;
+  egl_context = context;
+
+  if (gladLoadGLLoader((GLADloadproc)eglGetProcAddress) == 0) {
+    std::cout << "Failed to initialize GLAD\n";
+    exit(1);
+  }
+
+  int max_samples{1};
+  glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+  int samples = std::min(OFFSCREEN_SAMPLES, max_samples);
+
+  glGenRenderbuffers(3, offscreen_RBOs);
+  glGenFramebuffers(1, &offscreen_FBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, offscreen_FBO);
+  glBindRenderbuffer(GL_RENDERBUFFER, offscreen_RBOs[0]);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width,
+                                   height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, offscreen_RBOs[0]);
+  glBindRenderbuffer(GL_RENDERBUFFER, offscreen_RBOs[1]);
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples,
+                                   GL_DEPTH24_STENCIL8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, offscreen_RBOs[1]);
+
+  glGenFramebuffers(1, &resolve_FBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, resolve_FBO);
+  glBindRenderbuffer(GL_RENDERBUFFER, offscreen_RBOs[2]);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, offscreen_RBOs[2]);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "Error, incomplete offscreen framebuffer\n";
+    exit(1);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, offscreen_FBO);
+  glViewport(0, 0, width, height);
+  glEnable(GL_MULTISAMPLE); // anti-aliasing
+  glDepthRange(1, 0);       // Makes opengl right-handed
+  glCheckError();
+}
+
+void MeshRender::finalize_headless() {
+  glDeleteFramebuffers(1, &offscreen_FBO);
+  glDeleteFramebuffers(1, &resolve_FBO);
+  glDeleteRenderbuffers(3, offscreen_RBOs);
+  eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                 EGL_NO_CONTEXT);
+  eglDestroyContext(egl_display, egl_context);
+  eglTerminate(egl_display);
+}
+
+void MeshRender::bind_read_framebuffer() {
+  /* In headless mode, resolves the multisampled frame and binds it for
+   * reading, otherwise the back buffer of the window is read. */
+  if (headless) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, offscreen_FBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolve_FBO);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, resolve_FBO);
+  }
+}
+
+void MeshRender::read_pixels(std::vector<unsigned char> &rgb,
+                             int image_width, int image_height) {
+  /* Reads the last drawn frame, rows from top to bottom. */
+  rgb.resize((long)image_width * image_height * 3);
+  bind_read_framebuffer();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, image_width, image_height, GL_RGB, GL_UNSIGNED_BYTE,
+               rgb.data());
+  if (headless) {
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen_FBO);
+  }
+
+  long int row_size = (long)image_width * 3;
+  for (long int y = 0; y < image_height / 2; ++y) {
+    std::swap_ranges(rgb.begin() + y * row_size,
+                     rgb.begin() + (y + 1) * row_size,
+                     rgb.begin() + (image_height - 1 - y) * row_size);
+  }
+}
+
+void MeshRender::render_to_file(const std::string &fname) {
+  /* In a window, the image has the size of the framebuffer, larger than
+   * the window on HiDPI displays, as the captured frames. */
+  init_frame();
+  int image_width{width};
+  int image_height{height};
+  if (headless) {
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen_FBO);
+  } else {
+    glfwGetWindowSize(window, &width, &height);
+    glfwGetFramebufferSize(window, &image_width, &image_height);
+  }
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  draw_objects();
+
+  std::vector<unsigned char> rgb;
+  timer.begin(FramePhase::CAPTURE);
+  read_pixels(rgb, image_width, image_height);
+  timer.end(FramePhase::CAPTURE);
+  timer.end_frame();
+  ImageFile::write(fname, image_width, image_height, rgb);
+  glCheckError();
+}
+
+void MeshRender::start_capture(const std::string &fname_pattern) {
+  capture.start(fname_pattern);
+}
+
+void MeshRender::stop_capture() { capture.stop(); }
+
+void MeshRender::capture_frame() {
+  if (!capture.active()) {
+    return;
+  }
+  bind_read_framebuffer();
+  if (headless) {
+    capture.capture(width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen_FBO);
+  } else {
+    int fb_width{0};
+    int fb_height{0};
+    glfwGetFramebufferSize(window, &fb_width, &fb_height);
+    capture.capture(fb_width, fb_height);
+  }
+}
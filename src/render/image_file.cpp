@@ -0,0 +1,134 @@
+#include "image_file.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// maximum length of a stored deflate block
+constexpr long int STORED_BLOCK_SIZE{65535};
+
+static auto open_file(const std::string &fname) -> std::ofstream {
+  std::ofstream file(fname, std::ios::binary | std::ios::out);
+  if (!file.is_open()) {
+    throw std::invalid_argument("Can't open " + fname + " in " +
+                                std::string(__func__) + "\n");
+  }
+  return file;
+}
+
+void ImageFile::write(const std::string &fname, int width, int height,
+                      const std::vector<unsigned char> &rgb) {
+  auto ends_with = [&fname](const std::string &ext) {
+    return fname.size() >= ext.size() &&
+           fname.compare(fname.size() - ext.size(), ext.size(), ext) == 0;
+  };
+  if (ends_with(".png")) {
+    write_png(fname, width, height, rgb);
+  } else if (ends_with(".ppm")) {
+    write_ppm(fname, width, height, rgb);
+  } else {
+    throw std::invalid_argument("Unknown image extension, " + fname +
+                                " in " + std::string(__func__) + "\n");
+  }
+}
+
+void ImageFile::write_ppm(const std::string &fname, int width, int height,
+                          const std::vector<unsigned char> &rgb) {
+  std::ofstream file = open_file(fname);
+  file << "P6\n" << width << " " << height << "\n255\n";
+  file.write((const char *)rgb.data(), (long)width * height * 3);
+}
+
+static auto crc32(const unsigned char *data, long int length,
+                  uint32_t crc = 0) -> uint32_t {
+  // initialized once, even if images are written from several threads
+  static const std::array<uint32_t, 256> table = []() {
+    std::array<uint32_t, 256> crc_table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) != 0 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      }
+      crc_table[i] = c;
+    }
+    return crc_table;
+  }();
+  crc = ~crc;
+  for (long int i = 0; i < length; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static void push_u32(std::vector<unsigned char> &out, uint32_t value) {
+  // big endian
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back((unsigned char)(value >> shift));
+  }
+}
+
+static void write_chunk(std::ofstream &file, const char *type,
+                        const std::vector<unsigned char> &data) {
+  std::vector<unsigned char> chunk;
+  chunk.reserve(data.size() + 12);
+  push_u32(chunk, (uint32_t)data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  // the crc covers the type and the data
+  push_u32(chunk, crc32(chunk.data() + 4, (long)data.size() + 4));
+  file.write((const char *)chunk.data(), (long)chunk.size());
+}
+
+void ImageFile::write_png(const std::string &fname, int width, int height,
+                          const std::vector<unsigned char> &rgb) {
+  /* Each row is preceded by its filter type (0, none), the rows are stored
+   * in a zlib stream made of uncompressed deflate blocks. */
+  long int row_size = (long)width * 3 + 1;
+  std::vector<unsigned char> raw((long)height * row_size);
+  for (long int y = 0; y < height; ++y) {
+    raw[y * row_size] = 0;
+    std::copy(rgb.begin() + y * width * 3, rgb.begin() + (y + 1) * width * 3,
+              raw.begin() + y * row_size + 1);
+  }
+
+  std::vector<unsigned char> idat{0x78, 0x01}; // zlib header, no compression
+  idat.reserve(raw.size() + raw.size() / STORED_BLOCK_SIZE * 5 + 16);
+  long int position{0};
+  do {
+    long int length = std::min(STORED_BLOCK_SIZE, (long)raw.size() - position);
+    bool final_block = position + length == (long)raw.size();
+    idat.push_back(final_block ? 1 : 0);
+    idat.push_back((unsigned char)(length & 0xFF));
+    idat.push_back((unsigned char)(length >> 8));
+    idat.push_back((unsigned char)(~length & 0xFF));
+    idat.push_back((unsigned char)((~length >> 8) & 0xFF));
+    idat.insert(idat.end(), raw.begin() + position,
+                raw.begin() + position + length);
+    position += length;
+  } while (position < (long)raw.size());
+
+  uint32_t a{1};
+  uint32_t b{0};
+  for (unsigned char c : raw) {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+  push_u32(idat, (b << 16) | a); // adler32
+
+  std::vector<unsigned char> header;
+  push_u32(header, (uint32_t)width);
+  push_u32(header, (uint32_t)height);
+  // 8 bits, RGB, deflate, adaptive filtering, no interlace
+  header.insert(header.end(), {8, 2, 0, 0, 0});
+
+  std::ofstream file = open_file(fname);
+  const unsigned char signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                     '\n'};
+  file.write((const char *)signature, sizeof(signature));
+  write_chunk(file, "IHDR", header);
+  write_chunk(file, "IDAT", idat);
+  write_chunk(file, "IEND", {});
+}
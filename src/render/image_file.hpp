@@ -0,0 +1,22 @@
+#ifndef IMAGE_FILE_H_
+#define IMAGE_FILE_H_
+#include <string>
+#include <vector>
+
+namespace ImageFile {
+
+// Writes 8 bits RGB pixels, rows from top to bottom, as a .png or a .ppm
+// file depending on the file name extension.
+void write(const std::string &fname, int width, int height,
+           const std::vector<unsigned char> &rgb);
+
+void write_ppm(const std::string &fname, int width, int height,
+               const std::vector<unsigned char> &rgb);
+
+// Uncompressed (stored) deflate blocks, no dependency on zlib.
+void write_png(const std::string &fname, int width, int height,
+               const std::vector<unsigned char> &rgb);
+
+} // namespace ImageFile
+
+#endif // IMAGE_FILE_H_
@@ -0,0 +1,163 @@
+/* These methods draw the text overlay of the frame timings. */
+#include "frame_timer.hpp"
+#include "trimesh_render.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 5x7 glyphs of the ASCII characters 32 (space) to 95 (_), the lower case
+// letters are shown in upper case. Two words per glyph, one byte per row
+// from the top, the leftmost pixel in bit 4.
+constexpr int FONT_FIRST{32};
+constexpr int FONT_SIZE{64};
+static const unsigned int FONT[FONT_SIZE * 2]{
+    0x00000000, 0x000000, 0x04040404, 0x040004, 0x000A0A0A, 0x000000,
+    0x0A1F0A0A, 0x0A0A1F, 0x0E140F04, 0x041E05, 0x04021918, 0x031308,
+    0x0814120C, 0x0D1215, 0x0008040C, 0x000000, 0x08080402, 0x020408,
+    0x02020408, 0x080402, 0x0E150400, 0x000415, 0x1F040400, 0x000404,
+    0x00000000, 0x08040C, 0x1F000000, 0x000000, 0x00000000, 0x0C0C00,
+    0x04020100, 0x001008, 0x1513110E, 0x0E1119, 0x04040C04, 0x0E0404,
+    0x0201110E, 0x1F0804, 0x0204021F, 0x0E1101, 0x120A0602, 0x02021F,
+    0x011E101F, 0x0E1101, 0x1E100806, 0x0E1111, 0x0402011F, 0x080808,
+    0x0E11110E, 0x0E1111, 0x0F11110E, 0x0C0201, 0x000C0C00, 0x000C0C,
+    0x000C0C00, 0x08040C, 0x10080402, 0x020408, 0x001F0000, 0x00001F,
+    0x01020408, 0x080402, 0x0201110E, 0x040004, 0x0D01110E, 0x0E1515,
+    0x1111110E, 0x11111F, 0x1E11111E, 0x1E1111, 0x1010110E, 0x0E1110,
+    0x1111121C, 0x1C1211, 0x1E10101F, 0x1F1010, 0x1E10101F, 0x101010,
+    0x1710110E, 0x0F1111, 0x1F111111, 0x111111, 0x0404040E, 0x0E0404,
+    0x02020207, 0x0C1202, 0x18141211, 0x111214, 0x10101010, 0x1F1010,
+    0x15151B11, 0x111111, 0x15191111, 0x111113, 0x1111110E, 0x0E1111,
+    0x1E11111E, 0x101010, 0x1111110E, 0x0D1215, 0x1E11111E, 0x111214,
+    0x0E10100F, 0x1E0101, 0x0404041F, 0x040404, 0x11111111, 0x0E1111,
+    0x11111111, 0x040A11, 0x15111111, 0x0A1515, 0x040A1111, 0x11110A,
+    0x0A111111, 0x040404, 0x0402011F, 0x1F1008, 0x0808080E, 0x0E0808,
+    0x04081000, 0x000102, 0x0202020E, 0x0E0202, 0x00110A04, 0x000000,
+    0x00000000, 0x1F0000,
+};
+
+// seconds between the refreshes of the text, to keep it readable
+constexpr double OVERLAY_PERIOD{0.5};
+// slowest objects listed with per object timing
+constexpr int OVERLAY_OBJECTS{5};
+
+void MeshRender::set_timing(bool enabled, bool per_object) {
+  if (enabled) {
+    timer.start(per_object);
+  } else {
+    timer.stop();
+    stats_overlay = false;
+  }
+  overlay_chars.clear();
+  redraw = true;
+}
+
+void MeshRender::set_stats_overlay(bool enabled) {
+  if (enabled && !timer.active()) {
+    timer.start(false);
+  }
+  stats_overlay = enabled;
+  overlay_chars.clear();
+  redraw = true;
+}
+
+void MeshRender::init_overlay() {
+  /* One instance per character: column, row and glyph index. */
+  ShaderProgram &program = get_program(ShaderProgramType::TEXT_OVERLAY);
+  glUseProgram(program.id);
+  glUniform2uiv(glGetUniformLocation(program.id, "font"), FONT_SIZE, FONT);
+
+  glGenVertexArrays(1, &overlay_VAO);
+  glGenBuffers(1, &overlay_VBO);
+  glBindVertexArray(overlay_VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, overlay_VBO);
+  glVertexAttribIPointer(0, 3, GL_INT, 3 * sizeof(int), (void *)0);
+  glVertexAttribDivisor(0, 1);
+  glEnableVertexAttribArray(0);
+  glBindVertexArray(VAO);
+}
+
+void MeshRender::write_overlay_text() {
+  /* Mean durations in milliseconds, CPU and GPU, the lines are padded to
+   * the same length for the background. */
+  std::vector<std::string> lines;
+  char line[64];
+  PhaseTimings frame = timer.phase_timings(FramePhase::FRAME);
+  double fps = frame.cpu.mean > 0 ? 1000.0 / frame.cpu.mean : 0;
+  std::snprintf(line, sizeof(line), "FRAME %7.2f MS %6.1f FPS",
+                frame.cpu.mean, fps);
+  lines.emplace_back(line);
+  lines.emplace_back("          CPU MS   GPU MS");
+  const std::pair<FramePhase, const char *> phases[]{
+      {FramePhase::UPDATE, "UPDATE"},
+      {FramePhase::UPLOAD, "UPLOAD"},
+      {FramePhase::DRAW, "DRAW"},
+      {FramePhase::CAPTURE, "CAPTURE"},
+      {FramePhase::FRAME, "TOTAL"}};
+  for (const auto &[phase, name] : phases) {
+    PhaseTimings timings = timer.phase_timings(phase);
+    std::snprintf(line, sizeof(line), "%-8s %7.2f  %7.2f", name,
+                  timings.cpu.mean, timings.gpu.mean);
+    lines.emplace_back(line);
+  }
+  std::snprintf(line, sizeof(line), "OBJECTS %d CULLED %d",
+                culling_stats.n_objects, culling_stats.n_culled);
+  lines.emplace_back(line);
+
+  if (timer.timing_objects()) {
+    std::vector<std::pair<double, int>> slowest;
+    for (int id : timer.timed_objects()) {
+      slowest.emplace_back(timer.object_timings(id).mean, id);
+    }
+    std::sort(slowest.rbegin(), slowest.rend());
+    slowest.resize(std::min((int)slowest.size(), OVERLAY_OBJECTS));
+    for (const auto &[ms, id] : slowest) {
+      std::snprintf(line, sizeof(line), "OBJECT %-5d      %7.2f", id, ms);
+      lines.emplace_back(line);
+    }
+  }
+
+  unsigned long length{0};
+  for (const std::string &text : lines) {
+    length = std::max(length, text.size());
+  }
+  overlay_chars.clear();
+  for (int row = 0; row < (int)lines.size(); ++row) {
+    lines[row].resize(length, ' ');
+    for (int column = 0; column < (int)length; ++column) {
+      int c = std::toupper((unsigned char)lines[row][column]) - FONT_FIRST;
+      if (c < 0 || c >= FONT_SIZE) {
+        c = '?' - FONT_FIRST;
+      }
+      overlay_chars.insert(overlay_chars.end(), {column, row, c});
+    }
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, overlay_VBO);
+  glBufferData(GL_ARRAY_BUFFER, (long)(overlay_chars.size() * sizeof(int)),
+               overlay_chars.data(), GL_DYNAMIC_DRAW);
+  overlay_time = std::chrono::steady_clock::now();
+}
+
+void MeshRender::draw_overlay() {
+  /* Drawn over the objects, after the capture of the frame. */
+  if (!stats_overlay) {
+    return;
+  }
+  if (overlay_VAO == 0) {
+    init_overlay();
+  }
+  std::chrono::duration<double> age =
+      std::chrono::steady_clock::now() - overlay_time;
+  if (overlay_chars.empty() || age.count() >= OVERLAY_PERIOD) {
+    write_overlay_text();
+  }
+  glDisable(GL_DEPTH_TEST);
+  glUseProgram(get_program(ShaderProgramType::TEXT_OVERLAY).id);
+  glBindVertexArray(overlay_VAO);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                        (int)overlay_chars.size() / 3);
+  glBindVertexArray(VAO);
+  glEnable(GL_DEPTH_TEST);
+}
@@ -0,0 +1,69 @@
+#include "stream_buffer.hpp"
+#include "glad/include/glad/glad.h"
+#include <cstdint>
+
+// regions start on a multiple of this size (bytes)
+constexpr long int REGION_ALIGNMENT{256};
+constexpr uint64_t FENCE_TIMEOUT{1000000000}; // ns
+
+auto StreamBuffer::supported() -> bool { return GLAD_GL_VERSION_4_4 != 0; }
+
+void StreamBuffer::init(long int size) {
+  /* The storage is immutable, coherent mapping makes the writes visible to
+   * the GPU without explicit flush. */
+  region_size = (size + REGION_ALIGNMENT - 1) / REGION_ALIGNMENT *
+                REGION_ALIGNMENT;
+  if (region_size == 0) {
+    region_size = REGION_ALIGNMENT;
+  }
+  GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT |
+      GL_MAP_COHERENT_BIT;
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  glBufferStorage(GL_ARRAY_BUFFER, region_size * N_REGIONS, nullptr, flags);
+  mapped = (char *)glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                                    region_size * N_REGIONS, flags);
+  current = 0;
+}
+
+void StreamBuffer::destroy() {
+  for (auto &fence : fences) {
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  if (buffer != 0) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glDeleteBuffers(1, &buffer);
+  }
+  buffer = 0;
+  mapped = nullptr;
+}
+
+auto StreamBuffer::next_region() -> void * {
+  current = (current + 1) % N_REGIONS;
+  GLsync &fence = fences[current];
+  if (fence != nullptr) {
+    GLenum status{GL_TIMEOUT_EXPIRED};
+    while (status == GL_TIMEOUT_EXPIRED) {
+      status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                FENCE_TIMEOUT);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  return mapped + offset();
+}
+
+void StreamBuffer::fence() {
+  // a later fence also covers the previous draws of the region
+  GLsync &fence = fences[current];
+  if (fence != nullptr) {
+    glDeleteSync(fence);
+  }
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,48 @@
+#ifndef STREAM_BUFFER_H_
+#define STREAM_BUFFER_H_
+#include "glad/include/glad/glad.h"
+
+class StreamBuffer {
+  /* Buffer persistently mapped in the client memory, split in N_REGIONS
+   * regions written in turn. The CPU writes the next region while the GPU
+   * reads the previous ones; a fence per region ensures that a region is
+   * not overwritten before the draws reading it are done.
+   * Requires openGL 4.4 (glBufferStorage). */
+public:
+  static constexpr int N_REGIONS{3};
+
+private:
+  unsigned int buffer{0};
+  long int region_size{0}; // bytes, aligned
+  char *mapped{nullptr};
+  GLsync fences[N_REGIONS]{nullptr, nullptr, nullptr};
+  int current{0}; // region read by the next draws
+
+public:
+  [[nodiscard]] static auto supported() -> bool;
+
+  // Creates the buffer, size is the size of one region in bytes.
+  void init(long int size);
+  void destroy();
+
+  // Waits until the next region is no longer read by the GPU, and makes it
+  // the current region. The returned pointer is meant to be written only,
+  // reading mapped memory is slow.
+  auto next_region() -> void *;
+
+  // To be called after the draws reading the current region.
+  void fence();
+
+  [[nodiscard]] auto id() const -> unsigned int { return buffer; }
+  [[nodiscard]] auto size() const -> long int { return region_size; }
+  // offset of the current region in the buffer, in bytes
+  [[nodiscard]] auto offset() const -> long int {
+    return current * region_size;
+  }
+  // current region, readable for picking
+  [[nodiscard]] auto data() const -> const void * {
+    return mapped + offset();
+  }
+};
+
+#endif // STREAM_BUFFER_H_
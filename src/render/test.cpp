@@ -216,6 +216,9 @@ auto main() -> int {
   render.update_object(icosahedron_vertices, icosahedron_faces, cube_colors,
                        ico_id);
 
+  // The animated positions are written directly in GPU visible memory
+  render.set_streaming(ico_id);
+
   // Arguments for the animation callback
   Fargs ico_args = {.vertices = &icosahedron_vertices,
                     .colors = &cube_colors,
@@ -0,0 +1,64 @@
+/* test implementation */
+#include "../bvh.hpp"
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+constexpr int N{64}; // grid of N x N vertices
+
+static void wave(std::vector<float> &positions, double t) {
+  for (int i = 0; i < N; ++i) {
+    for (int j = 0; j < N; ++j) {
+      float *p = &positions[(i * N + j) * 3];
+      p[0] = (float)i / (N - 1) - 0.5F;
+      p[1] = (float)j / (N - 1) - 0.5F;
+      p[2] = (float)(0.2 * std::sin(8 * p[0] + t) * std::cos(5 * p[1]));
+    }
+  }
+}
+
+auto main() -> int {
+  std::cout << "\n++++++++ Test bvh refit +++++++\n\n";
+  std::vector<float> positions(N * N * 3);
+  std::vector<unsigned int> faces;
+  for (unsigned int i = 0; i + 1 < N; ++i) {
+    for (unsigned int j = 0; j + 1 < N; ++j) {
+      unsigned int v = i * N + j;
+      faces.insert(faces.end(), {v, v + N, v + 1, v + 1, v + N, v + N + 1});
+    }
+  }
+  long int n_faces = (long int)faces.size() / 3;
+
+  Bvh refitted;
+  wave(positions, 0);
+  refitted.build(positions.data(), 3, N * N, faces.data(), n_faces);
+  wave(positions, 2);
+  std::cout << "refit : " << refitted.refit(positions.data(), 3, N * N)
+            << "\n";
+  std::cout << "refit other vertices count : "
+            << refitted.refit(positions.data(), 3, N * N - 1) << "\n";
+  Bvh built;
+  built.build(positions.data(), 3, N * N, faces.data(), n_faces);
+
+  // vertical rays on a grid, both trees find the same hits (a ray through
+  // an edge can report either face)
+  int n_hits{0};
+  int n_same{0};
+  double direction[]{0, 0, -1};
+  for (int i = 0; i < 40; ++i) {
+    for (int j = 0; j < 40; ++j) {
+      double origin[]{(i + 0.5) / 40 - 0.5, (j + 0.5) / 40 - 0.5, 1};
+      RayHit hit_refitted;
+      RayHit hit_built;
+      bool found = refitted.intersect(origin, direction, 0, 10, hit_refitted);
+      if (found != built.intersect(origin, direction, 0, 10, hit_built)) {
+        continue;
+      }
+      n_hits += found ? 1 : 0;
+      n_same += hit_refitted.t == hit_built.t ? 1 : 0;
+    }
+  }
+  std::cout << "rays : 1600, hits : " << n_hits << ", same : " << n_same
+            << "\n";
+  return 0;
+}
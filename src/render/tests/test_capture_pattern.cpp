@@ -0,0 +1,37 @@
+/* test implementation */
+#include "../trimesh_render.hpp"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+auto main() -> int {
+  std::cout << "\n++++++++ Test capture pattern +++++++\n\n";
+  MeshRender render(64, 64, RenderMode::HEADLESS);
+  render.add_mesh(std::vector<double>{0, 0, 0, 0.5, 0, 0, 0, 0.5, 0},
+                  std::vector<unsigned int>{0, 1, 2});
+
+  std::vector<std::string> patterns{
+      "tests/capture_%d.ppm", "tests/capture_%+05i%%.ppm",
+      "tests/capture_%40d.ppm", "tests/capture.ppm",
+      "tests/capture_%d_%d.ppm", "tests/capture_%s.ppm",
+      "tests/capture_%ld.ppm", "tests/capture_%*d.ppm",
+      "tests/capture_%"};
+  for (const std::string &pattern : patterns) {
+    try {
+      render.start_capture(pattern);
+      render.draw_frame();
+      render.stop_capture();
+      std::cout << pattern << " : accepted\n";
+    } catch (const std::invalid_argument &) {
+      std::cout << pattern << " : throws invalid_argument\n";
+    }
+  }
+
+  // the width of the conversion is not truncated
+  std::ifstream wide("tests/capture_" + std::string(39, ' ') + "0.ppm");
+  std::cout << "wide conversion written : " << wide.good() << "\n";
+  render.render_finalize();
+  return 0;
+}
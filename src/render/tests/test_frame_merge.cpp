@@ -0,0 +1,59 @@
+/* test implementation */
+#include "../triple_buffer.hpp"
+#include "../trimesh_render.hpp"
+#include <iostream>
+#include <vector>
+
+static void print_frame(const SimulationFrame &frame) {
+  for (const FrameObject &update : frame.objects) {
+    std::cout << "object " << update.id << " : " << update.vertices.size()
+              << " vertices coords, " << update.colors.size()
+              << " colors, " << update.faces.size() << " faces indices\n";
+  }
+}
+
+static void publish(TripleBuffer<SimulationFrame> &frames,
+                    const std::vector<FrameObject> &objects) {
+  // as render_loop_async
+  SimulationFrame &frame = frames.write_slot();
+  frame.objects = objects;
+  if (const SimulationFrame *unread = frames.unread_slot()) {
+    frame.merge(*unread);
+  }
+  frames.publish();
+}
+
+auto main() -> int {
+  std::cout << "\n++++++++ Test frame merge +++++++\n\n";
+  std::vector<double> coords(9, 0.5);
+  std::vector<double> colors(9, 1.0);
+  std::vector<unsigned int> faces{0, 1, 2};
+
+  TripleBuffer<SimulationFrame> frames;
+  std::cout << "unread slot : " << (frames.unread_slot() != nullptr) << "\n";
+
+  // the colors of 0 are published, then replaced by a frame updating 1
+  publish(frames, {FrameObject{0, {}, colors, {}}});
+  publish(frames, {FrameObject{1, coords, {}, {}}});
+  frames.update();
+  std::cout << "\n ++++++++++ skipped colors  ++++++\n";
+  print_frame(frames.read_slot());
+  std::cout << "unread slot : " << (frames.unread_slot() != nullptr) << "\n";
+
+  // read frames are not merged
+  std::cout << "\n ++++++++++ read frame  ++++++\n";
+  publish(frames, {FrameObject{1, {}, colors, {}}});
+  frames.update();
+  print_frame(frames.read_slot());
+
+  // the newer fields win, the faces come with the older vertices
+  std::cout << "\n ++++++++++ partial fields  ++++++\n";
+  publish(frames, {FrameObject{0, coords, {}, faces}});
+  publish(frames, {FrameObject{0, {}, colors, {}}});
+  publish(frames, {FrameObject{1, coords, colors, faces},
+                   FrameObject{0, coords, {}, {}}});
+  frames.update();
+  print_frame(frames.read_slot());
+  std::cout << "unread slot : " << (frames.unread_slot() != nullptr) << "\n";
+  return 0;
+}
@@ -0,0 +1,93 @@
+/* test implementation */
+#include "../trimesh_render.hpp"
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static auto read_file(const std::string &fname) -> std::vector<char> {
+  std::ifstream file(fname, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+template <class F> void expect_throw(const std::string &name, F update) {
+  try {
+    update();
+    std::cout << name << " : no exception\n";
+  } catch (const std::invalid_argument &) {
+    std::cout << name << " : throws invalid_argument\n";
+  }
+}
+
+auto main() -> int {
+  std::cout << "\n++++++++ Test remove object +++++++\n\n";
+
+  std::vector<double> cube_vertices{
+      -1, -1, -1, 1, -1, -1, 1, -1, 1, -1, -1, 1, //
+      -1, 1,  -1, 1, 1,  -1, 1, 1,  1, -1, 1,  1,
+  };
+  for (auto &v : cube_vertices) {
+    v *= 0.25;
+  }
+  std::vector<unsigned int> cube_faces{0, 1, 2, 2, 3, 0, 1, 5, 6, 6, 2, 1,
+                                       2, 6, 7, 2, 7, 3, 0, 3, 4, 4, 3, 7,
+                                       5, 4, 7, 5, 7, 6, 1, 0, 4, 1, 4, 5};
+  std::vector<double> tet_vertices{0.3,  0.3,  0.3,  0.3,  -0.3, -0.3,
+                                   -0.3, 0.3,  -0.3, -0.3, -0.3, 0.3};
+  std::vector<unsigned int> tet_faces{0, 1, 3, 1, 2, 3, 1, 2, 0, 2, 0, 3};
+  std::vector<double> curve{-0.5, -0.5, 0, 0, 0.5, 0, 0.5, -0.5, 0};
+
+  MeshRender render(200, 200, RenderMode::HEADLESS);
+  int cube_id = render.add_mesh(cube_vertices, cube_faces);
+  int tet_id = render.add_mesh(tet_vertices, tet_faces);
+  int curve_id = render.add_curve(curve, std::vector<double>{0.9, 0.2, 0.2},
+                                  CurveType::TUBE_CURVE, 0.02);
+  render.remove_object(cube_id);
+  std::cout << "remaining objects : " << tet_id << " " << curve_id << "\n";
+  render.render_to_file("tests/remove_object_before.ppm");
+
+  // data of the size of the removed cube, far from the other objects
+  std::vector<double> vertices(cube_vertices.size(), 10.0);
+  std::vector<double> colors(cube_vertices.size(), 1.0);
+  std::vector<double> scalars(cube_vertices.size() / 3, 1.0);
+  expect_throw("update_object(vertices)",
+               [&] { render.update_object(vertices, cube_id); });
+  expect_throw("update_object(vertices, faces)", [&] {
+    render.update_object(vertices, cube_faces, cube_id);
+  });
+  expect_throw("update_object(vertices, faces, colors)", [&] {
+    render.update_object(vertices, cube_faces, colors, cube_id);
+  });
+  expect_throw("update_vertex_colors(colors)",
+               [&] { render.update_vertex_colors(colors, cube_id); });
+  expect_throw("update_vertex_colors(colors, first)", [&] {
+    render.update_vertex_colors(std::vector<double>{1, 1, 1}, cube_id, 0);
+  });
+  expect_throw("update_vertex_scalars",
+               [&] { render.update_vertex_scalars(scalars, cube_id); });
+  expect_throw("update_vertex_normals",
+               [&] { render.update_vertex_normals(colors, cube_id); });
+  expect_throw("update_vectors", [&] {
+    render.update_vectors(cube_id, vertices, vertices, colors);
+  });
+  expect_throw("set_streaming", [&] { render.set_streaming(cube_id); });
+  expect_throw("set_object_transform", [&] {
+    render.set_object_transform(cube_id, std::vector<double>{1, 0, 0}, 2);
+  });
+  expect_throw("set_object_tint", [&] {
+    render.set_object_tint(cube_id, std::vector<double>{1, 0, 0});
+  });
+  expect_throw("set_colormap_range",
+               [&] { render.set_colormap_range(cube_id, 0, 1); });
+
+  render.render_to_file("tests/remove_object_after.ppm");
+  std::vector<char> before = read_file("tests/remove_object_before.ppm");
+  std::vector<char> after = read_file("tests/remove_object_after.ppm");
+  std::cout << "other objects unchanged : "
+            << (!before.empty() && before == after ? "yes" : "no") << "\n";
+  render.render_finalize();
+  return 0;
+}
@@ -1,16 +1,21 @@
 #include "trimesh_render.hpp"
+#include "../mesh/parallel.hpp"
 #include "compile_shader.hpp"
 #include "glad/include/glad/glad.h" // glad should be included before glfw3
 #include "linalg.hpp"
 #include "quatern_transform.hpp"
+#include "triple_buffer.hpp"
 #include "vector_instance.hpp"
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <map>
-#include <numeric>
 #include <string>
+#include <thread>
 
 auto glCheckError_(const char *file, int line) -> GLenum;
 #define glCheckError() glCheckError_(__FILE__, __LINE__)
@@ -18,9 +23,50 @@ auto glCheckError_(const char *file, int line) -> GLenum;
 constexpr double MOUSE_SENSITIVITY{0.005};
 constexpr double SCROLL_SENSITIVITY{0.05};
 
-void framebuffer_size_callback(__attribute__((unused)) GLFWwindow *window,
-                               int width, int height) {
+static auto fits_short(const std::vector<unsigned int> &indices) -> bool {
+  return std::all_of(indices.begin(), indices.end(),
+                     [](unsigned int i) { return i <= UINT16_MAX; });
+}
+
+static auto color_byte(double color) -> uint8_t {
+  // rounded, the value is positive
+  return (uint8_t)(std::clamp(color, 0.0, 1.0) * UINT8_MAX + 0.5);
+}
+
+static auto normal_short(float coord) -> int16_t {
+  return (int16_t)std::lround(std::clamp(coord, -1.0F, 1.0F) * INT16_MAX);
+}
+
+static void octahedral(const double *normal, float *oct) {
+  /* Projects a normal on the octahedron |x| + |y| + |z| = 1, the lower half
+   * is folded on the corners of the square [-1, 1]^2. */
+  double l1 = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+  if (l1 == 0) {
+    oct[0] = 0;
+    oct[1] = 0;
+    return;
+  }
+  double x = normal[0] / l1;
+  double y = normal[1] / l1;
+  if (normal[2] < 0) {
+    double folded_x = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+    y = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+    x = folded_x;
+  }
+  oct[0] = (float)x;
+  oct[1] = (float)y;
+}
+
+void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
   glViewport(0, 0, width, height);
+  auto *render = (MeshRender *)glfwGetWindowUserPointer(window);
+  render->request_redraw();
+}
+
+void window_refresh_callback(GLFWwindow *window) {
+  // the window content was damaged
+  auto *render = (MeshRender *)glfwGetWindowUserPointer(window);
+  render->request_redraw();
 }
 
 void MeshRender::init_window() {
@@ -42,9 +88,11 @@ void MeshRender::init_window() {
 
   glfwSetKeyCallback(window, keyboard_callback);
   glfwSetCursorPosCallback(window, cursor_callback);
+  glfwSetMouseButtonCallback(window, mouse_button_callback);
   glfwSetScrollCallback(window, scroll_callback);
 
   glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+  glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
   if (gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) == 0) {
     std::cout << "Failed to initialize GLAD\n";
@@ -55,106 +103,577 @@ void MeshRender::init_window() {
   glDepthRange(1, 0);       // Makes opengl right-handed
 }
 
-void MeshRender::Object::set_shader_program() {
-
-  shader_program = create_program(OBJECT_SHADER_MAP.at(object_type));
-
-  glUseProgram(shader_program);
+auto MeshRender::get_program(ShaderProgramType type) -> ShaderProgram & {
+  /* Returns the program shared by the objects of this type,
+   * compiles it at the first call. */
+  auto found = programs.find(type);
+  if (found != programs.end()) {
+    return found->second;
+  }
 
-  q_loc = glGetUniformLocation(shader_program, "q");
-  q_inv_loc = glGetUniformLocation(shader_program, "q_inv");
-  zoom_loc = glGetUniformLocation(shader_program, "zoom_level");
-  viewport_size_loc = glGetUniformLocation(
-      shader_program, "viewport_size"); // for the aspect ratio
+  ShaderProgram &program = programs[type];
+  program.id = create_program(type);
+  program.first_object_loc = glGetUniformLocation(program.id, "first_object");
+  return program;
 }
 
 void MeshRender::init_storage() {
-
+  /* The attributes pointers and the EBO are set once in the VAO, the
+   * arenas keep the same buffers when growing.
+   * Each attribute has its own tightly packed stream. */
   glGenVertexArrays(1, &VAO);
   glGenBuffers(1, &VBO);
+  glGenBuffers(1, &color_VBO);
+  glGenBuffers(1, &scalar_VBO);
+  glGenBuffers(1, &normal_VBO);
   glGenBuffers(1, &EBO);
+  glGenBuffers(1, &indirect_buffer);
+  glGenBuffers(1, &objects_SSBO);
+  glGenBuffers(1, &camera_UBO);
+
+  // binding points declared in the shaders
+  glBindBuffer(GL_UNIFORM_BUFFER, camera_UBO);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, 0, camera_UBO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, objects_SSBO);
+
+  vertices_arena.init(GL_ARRAY_BUFFER, VBO, VERT_ATTR_LENGTHS.at(0));
+  colors_arena.init(GL_ARRAY_BUFFER, color_VBO, VERT_ATTR_LENGTHS.at(1));
+  scalars_arena.init(GL_ARRAY_BUFFER, scalar_VBO, VERT_ATTR_LENGTHS.at(2));
+  normals_arena.init(GL_ARRAY_BUFFER, normal_VBO, VERT_ATTR_LENGTHS.at(3));
+  indices_arena.init(GL_ELEMENT_ARRAY_BUFFER, EBO, 1);
+
+  const unsigned int streams[] = {VBO, color_VBO, scalar_VBO, normal_VBO};
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  for (int i = 0; i < (int)VERT_ATTR_LENGTHS.size(); ++i) {
+    glBindBuffer(GL_ARRAY_BUFFER, streams[i]);
+    glVertexAttribPointer(i, (int)VERT_ATTR_LENGTHS[i], GL_FLOAT, GL_FALSE,
+                          (int)(VERT_ATTR_LENGTHS[i] * sizeof(float)),
+                          (void *)0);
+    glEnableVertexAttribArray(i);
+  }
+
+  // the packed attributes are normalized to [0, 1] when read
+  glGenVertexArrays(1, &packed_VAO);
+  glGenBuffers(1, &packed_VBO);
+  glGenBuffers(1, &packed_color_VBO);
+  glGenBuffers(1, &packed_normal_VBO);
+  packed_vertices_arena.init(GL_ARRAY_BUFFER, packed_VBO,
+                             PACKED_ATTR_LENGTHS.at(0));
+  packed_colors_arena.init(GL_ARRAY_BUFFER, packed_color_VBO,
+                           PACKED_ATTR_LENGTHS.at(1));
+  packed_normals_arena.init(GL_ARRAY_BUFFER, packed_normal_VBO,
+                            PACKED_ATTR_LENGTHS.at(2));
+  glBindVertexArray(packed_VAO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBindBuffer(GL_ARRAY_BUFFER, packed_VBO);
+  glVertexAttribPointer(0, (int)PACKED_ATTR_LENGTHS[0], GL_UNSIGNED_SHORT,
+                        GL_TRUE,
+                        (int)(PACKED_ATTR_LENGTHS[0] * sizeof(uint16_t)),
+                        (void *)0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, packed_color_VBO);
+  glVertexAttribPointer(1, (int)PACKED_ATTR_LENGTHS[1], GL_UNSIGNED_BYTE,
+                        GL_TRUE,
+                        (int)(PACKED_ATTR_LENGTHS[1] * sizeof(uint8_t)),
+                        (void *)0);
+  glEnableVertexAttribArray(1);
+  // the scalar is the 4th component of the packed positions
+  glBindBuffer(GL_ARRAY_BUFFER, packed_VBO);
+  glVertexAttribPointer(2, 1, GL_UNSIGNED_SHORT, GL_TRUE,
+                        (int)(PACKED_ATTR_LENGTHS[0] * sizeof(uint16_t)),
+                        (void *)(3 * sizeof(uint16_t)));
+  glEnableVertexAttribArray(2);
+  glBindBuffer(GL_ARRAY_BUFFER, packed_normal_VBO);
+  glVertexAttribPointer(3, (int)PACKED_ATTR_LENGTHS[2], GL_SHORT, GL_TRUE,
+                        (int)(PACKED_ATTR_LENGTHS[2] * sizeof(int16_t)),
+                        (void *)0);
+  glEnableVertexAttribArray(3);
+  glBindVertexArray(VAO);
+
+  // the colormaps stay bound to the texture unit 0
+  glGenTextures(1, &colormaps_texture);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_1D_ARRAY, colormaps_texture);
+  glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_1D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glCheckError();
 }
 
-void MeshRender::resize_VBO() {
-  // Resize the VAO and update vertex attributes data
-  long int stride = (long int)sizeof(float) * vertices_stride();
+auto MeshRender::allocate_vertices(long int n, bool packed) -> long int {
+  // the arenas are deterministic, the same calls give the same offsets
+  if (packed) {
+    packed_colors_arena.allocate(n);
+    packed_normals_arena.allocate(n);
+    return packed_vertices_arena.allocate(n);
+  }
+  long int offset = vertices_arena.allocate(n);
+  colors_arena.allocate(n);
+  scalars_arena.allocate(n);
+  normals_arena.allocate(n);
+  return offset;
+}
 
-  int n_vertice_attr = (int)VERT_ATTR_LENGTHS.size();
-  long int offset{0 * sizeof(float)};
+auto MeshRender::resize_vertices(long int offset, long int n, long int new_n,
+                                 bool packed) -> long int {
+  // the scalars and normals are kept, the other streams are uploaded by
+  // the caller
+  auto keep = [offset, n, new_n](auto &arena) {
+    long int new_offset = arena.resize(offset, n, new_n);
+    if (new_offset != offset) {
+      arena.upload(new_offset, std::min(n, new_n));
+    }
+  };
+  if (packed) {
+    packed_colors_arena.resize(offset, n, new_n);
+    keep(packed_normals_arena);
+    return packed_vertices_arena.resize(offset, n, new_n);
+  }
+  colors_arena.resize(offset, n, new_n);
+  keep(scalars_arena);
+  keep(normals_arena);
+  return vertices_arena.resize(offset, n, new_n);
+}
 
-  glBindVertexArray(VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER,
-               (long)vertices_attr.size() * (long)sizeof(float),
-               vertices_attr.data(), GL_STATIC_DRAW);
+void MeshRender::release_vertices(long int offset, long int n, bool packed) {
+  if (packed) {
+    packed_vertices_arena.release(offset, n);
+    packed_colors_arena.release(offset, n);
+    packed_normals_arena.release(offset, n);
+    return;
+  }
+  vertices_arena.release(offset, n);
+  colors_arena.release(offset, n);
+  scalars_arena.release(offset, n);
+  normals_arena.release(offset, n);
+}
 
-  for (int i = 0; i < n_vertice_attr; ++i) {
-    // TODO do not hardcode 3 !
-    glVertexAttribPointer(i, (int)VERT_ATTR_LENGTHS[i], GL_FLOAT, GL_FALSE,
-                          (int)stride, (void *)(offset));
-    glEnableVertexAttribArray(i);
-    offset += VERT_ATTR_LENGTHS[i] * (long int)sizeof(float);
+void MeshRender::compact_storage() {
+  /* Packs the objects at the beginning of the buffers. The indices are
+   * relative to the object first vertex, so they are only moved. */
+  std::vector<ArenaRange> vertices_ranges;
+  std::vector<ArenaRange> packed_ranges;
+  std::vector<ArenaRange> indices_ranges;
+  for (const Object &obj : objects) {
+    if (obj.object_type != ObjectType::NONE) {
+      (obj.packed ? packed_ranges : vertices_ranges)
+          .push_back(
+              {obj.attr_offset / obj.total_number_attr, obj.n_vertices()});
+      indices_ranges.push_back(
+          {obj.faces_indices_offset, obj.indices_units()});
+    }
   }
+  std::vector<ArenaRange> colors_ranges(vertices_ranges);
+  std::vector<ArenaRange> scalars_ranges(vertices_ranges);
+  std::vector<ArenaRange> normals_ranges(vertices_ranges);
+  std::vector<ArenaRange> packed_colors_ranges(packed_ranges);
+  std::vector<ArenaRange> packed_normals_ranges(packed_ranges);
+  vertices_arena.compact(vertices_ranges);
+  colors_arena.compact(colors_ranges);
+  scalars_arena.compact(scalars_ranges);
+  normals_arena.compact(normals_ranges);
+  packed_vertices_arena.compact(packed_ranges);
+  packed_colors_arena.compact(packed_colors_ranges);
+  packed_normals_arena.compact(packed_normals_ranges);
+  indices_arena.compact(indices_ranges);
+
+  unsigned long i{0};
+  unsigned long i_vertices{0};
+  unsigned long i_packed{0};
+  for (Object &obj : objects) {
+    if (obj.object_type != ObjectType::NONE) {
+      const ArenaRange &range = obj.packed ? packed_ranges[i_packed++]
+                                           : vertices_ranges[i_vertices++];
+      obj.attr_offset = range.offset * obj.total_number_attr;
+      obj.faces_indices_offset = indices_ranges[i].offset;
+      ++i;
+    }
+  }
+  draw_commands_outdated = true;
 }
 
-void MeshRender::resize_EBO() {
-  // Square EBO
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               (long)sizeof(unsigned int) * faces.size(), faces.data(),
-               GL_STATIC_DRAW);
-  glCheckError();
+auto MeshRender::live_object(int id) -> Object & {
+  /* A removed object has no storage, its offsets would address the ranges
+   * of the other objects. */
+  Object &obj = objects.at(id);
+  if (obj.object_type == ObjectType::NONE) {
+    throw std::invalid_argument("The object has been removed in " +
+                                std::string(__func__) + "\n");
+  }
+  return obj;
 }
 
-auto MeshRender::render_loop(int (*data_update_function)(void *fargs),
-                             void *fargs) -> int {
+void MeshRender::remove_object(int id) {
+  /* The object is kept as a NONE object so that the ids are stable, its
+   * storage is freed and the buffers are compacted when the free space
+   * exceeds the space used by the remaining objects. */
+  Object &obj = objects.at(id);
+  if (obj.object_type == ObjectType::NONE) {
+    return;
+  }
+  release_vertices(obj.attr_offset / obj.total_number_attr, obj.n_vertices(),
+                   obj.packed);
+  indices_arena.release(obj.faces_indices_offset, obj.indices_units());
+  if (obj.instances_VAO != 0) {
+    obj.instances.destroy();
+    glDeleteBuffers(1, &obj.instances_VBO);
+    glDeleteVertexArrays(1, &obj.instances_VAO);
+  }
+  if (obj.stream.id() != 0) {
+    obj.stream.destroy();
+    glDeleteVertexArrays(1, &obj.stream_VAO);
+  }
+  obj = Object();
+  if (id < (int)objects_bvh.size()) {
+    objects_bvh[id] = Bvh();
+  }
+  draw_commands_outdated = true;
 
-  glBindVertexArray(VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  if (vertices_arena.free_size() * 2 > vertices_arena.used_size() ||
+      packed_vertices_arena.free_size() * 2 >
+          packed_vertices_arena.used_size() ||
+      indices_arena.free_size() * 2 > indices_arena.used_size()) {
+    compact_storage();
+  }
+}
 
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+template <class T>
+void MeshRender::pack_positions(Object &obj, const T *positions,
+                                long int n_vertices) {
+  /* Quantizes the positions in the object bounding box, the box is kept
+   * to decode them in the vertex shader. */
+  double min[3]{0, 0, 0};
+  double max[3]{0, 0, 0};
+  for (long int i = 0; i < n_vertices; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      double x = positions[i * 3 + k];
+      min[k] = i == 0 ? x : std::min(min[k], x);
+      max[k] = i == 0 ? x : std::max(max[k], x);
+    }
+  }
+  double inv_step[3];
+  for (int k = 0; k < 3; ++k) {
+    obj.position_offset[k] = (float)min[k];
+    obj.position_scale[k] = (float)(max[k] - min[k]);
+    inv_step[k] = max[k] > min[k] ? UINT16_MAX / (max[k] - min[k]) : 0;
+  }
 
-  int flag = 1;
-  glClearColor(0.0, 0.0, 0.0, 0.0);
+  uint16_t *packed =
+      packed_vertices_arena.host(obj.attr_offset / obj.total_number_attr);
+  for (long int i = 0; i < n_vertices; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      packed[i * 4 + k] = (uint16_t)std::lround(
+          (positions[i * 3 + k] - min[k]) * inv_step[k]);
+    }
+  }
+}
 
-  glEnable(GL_DEPTH_TEST);
-  // Accept fragment if closer to the camera
-  glDepthFunc(GL_LESS);
+void MeshRender::pack_scalars(Object &obj, const float *scalars) {
+  /* Quantizes the scalars in their range, in the 4th component of the
+   * packed positions. */
+  long int n_vertices = obj.n_vertices();
+  float min{0};
+  float max{0};
+  if (n_vertices > 0) {
+    auto [min_scalar, max_scalar] =
+        std::minmax_element(scalars, scalars + n_vertices);
+    min = *min_scalar;
+    max = *max_scalar;
+  }
+  obj.scalar_offset = min;
+  obj.scalar_scale = max - min;
+  double inv_step = max > min ? UINT16_MAX / ((double)max - min) : 0;
+
+  uint16_t *packed =
+      packed_vertices_arena.host(obj.attr_offset / obj.total_number_attr);
+  for (long int i = 0; i < n_vertices; ++i) {
+    packed[i * 4 + 3] = (uint16_t)std::lround((scalars[i] - min) * inv_step);
+  }
+}
 
-  if (data_update_function == nullptr) {
-    while ((glfwWindowShouldClose(window) == 0)) {
-      glfwGetWindowSize(window, &width, &height);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void MeshRender::unpack_scalars(const Object &obj,
+                                std::vector<float> &scalars) {
+  const uint16_t *packed =
+      packed_vertices_arena.host(obj.attr_offset / obj.total_number_attr);
+  scalars.resize(obj.n_vertices());
+  for (long int i = 0; i < obj.n_vertices(); ++i) {
+    scalars[i] = obj.scalar_offset +
+                 obj.scalar_scale * (float)packed[i * 4 + 3] / UINT16_MAX;
+  }
+}
 
-      for (auto &obj : objects) {
-        draw(obj);
-      }
-      glfwSwapBuffers(window);
-      glfwPollEvents();
+void MeshRender::set_packed(int id) {
+  /* Moves the object from the float streams to the packed streams. */
+  Object &obj = objects.at(id);
+  if (obj.packed) {
+    return;
+  }
+  if (obj.object_type == ObjectType::VECTOR) {
+    pack_instances(obj);
+    return;
+  }
+  if (obj.object_type == ObjectType::NONE ||
+      obj.object_type == ObjectType::AXIS_CROSS || obj.stream.id() != 0) {
+    throw std::invalid_argument("Removed objects, the axis cross and "
+                                "streamed objects can't be packed in " +
+                                std::string(__func__) + "\n");
+  }
+  long int n_vertices = obj.n_vertices();
+  long int offset = obj.attr_offset / obj.total_number_attr;
+  const float *positions = vertices_arena.host(offset);
+  const float *colors = colors_arena.host(offset);
+  const float *scalars = scalars_arena.host(offset);
+  const float *normals = normals_arena.host(offset);
+
+  long int packed_offset = allocate_vertices(n_vertices, true);
+  obj.packed = true;
+  obj.total_number_attr = PACKED_ATTR_LENGTHS.at(0);
+  obj.attr_offset = packed_offset * obj.total_number_attr;
+  obj.attr_length = n_vertices * obj.total_number_attr;
+  pack_positions(obj, positions, n_vertices);
+  pack_scalars(obj, scalars);
+  uint8_t *packed_colors = packed_colors_arena.host(packed_offset);
+  for (long int i = 0; i < n_vertices; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      packed_colors[i * 4 + k] = color_byte(colors[i * 3 + k]);
     }
-  } else {
-    while ((glfwWindowShouldClose(window) == 0) && (flag != 0)) {
+    packed_colors[i * 4 + 3] = UINT8_MAX;
+  }
+  int16_t *packed_normals = packed_normals_arena.host(packed_offset);
+  for (long int i = 0; i < n_vertices * 2; ++i) {
+    packed_normals[i] = normal_short(normals[i]);
+  }
+  packed_vertices_arena.upload(packed_offset, n_vertices);
+  packed_colors_arena.upload(packed_offset, n_vertices);
+  packed_normals_arena.upload(packed_offset, n_vertices);
 
-      glfwGetWindowSize(window, &width, &height);
-      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  release_vertices(offset, n_vertices, false);
+  draw_commands_outdated = true;
+}
 
-      for (auto &obj : objects) {
-        draw(obj);
-      }
-      glfwSwapBuffers(window);
-      glfwPollEvents();
+void MeshRender::set_streaming(int id) {
+  Object &obj = live_object(id);
+  if (obj.object_type == ObjectType::VECTOR || obj.packed) {
+    throw std::invalid_argument("Vectors and packed objects can't be "
+                                "streamed in " +
+                                std::string(__func__) + "\n");
+  }
+  if (!StreamBuffer::supported() || obj.stream.id() != 0) {
+    return;
+  }
+  init_stream(obj);
+  draw_commands_outdated = true;
+}
+
+void MeshRender::set_object_transform(int id,
+                                      const std::vector<double> &translation,
+                                      double scale) {
+  Object &obj = live_object(id);
+  if (translation.size() != 3 || scale <= 0) {
+    throw std::invalid_argument("Invalid translation or scale in " +
+                                std::string(__func__) + "\n");
+  }
+  for (int k = 0; k < 3; ++k) {
+    obj.transform[k] = (float)translation[k];
+  }
+  obj.transform[3] = (float)scale;
+  draw_commands_outdated = true;
+}
+
+void MeshRender::set_object_tint(int id, const std::vector<double> &tint) {
+  Object &obj = live_object(id);
+  if (tint.size() != 3) {
+    throw std::invalid_argument("Tint size should be 3 in " +
+                                std::string(__func__) + "\n");
+  }
+  for (int k = 0; k < 3; ++k) {
+    obj.tint[k] = (float)tint[k];
+  }
+  draw_commands_outdated = true;
+}
+
+void MeshRender::init_stream(Object &obj) {
+  /* The stream VAO reads the positions from the stream buffer and the
+   * other attributes from their streams, the offsets are set at each
+   * draw. */
+  obj.stream.init(obj.n_vertices() * VERT_ATTR_LENGTHS.at(0) *
+                  (long)sizeof(float));
+  if (obj.stream_VAO == 0) {
+    glGenVertexArrays(1, &obj.stream_VAO);
+    glBindVertexArray(obj.stream_VAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+    glBindVertexArray(VAO);
+  }
+  stream_positions(obj);
+}
+
+void MeshRender::stream_positions(Object &obj) {
+  // copies the host positions to the next region
+  const float *positions =
+      vertices_arena.host(obj.attr_offset / obj.total_number_attr);
+  std::copy(positions, positions + obj.attr_length,
+            (float *)obj.stream.next_region());
+}
+
+auto MeshRender::map_vertices(int id) -> float * {
+  Object &obj = live_object(id);
+  if (obj.stream.id() == 0) {
+    throw std::invalid_argument("Object is not streamed in " +
+                                std::string(__func__) + "\n");
+  }
+  obj.bvh_outdated = true;
+  obj.bounds[3] = -1; // written by the caller
+  redraw = true;
+  return (float *)obj.stream.next_region();
+}
+
+auto MeshRender::render_loop(int (*data_update_function)(void *fargs),
+                             void *fargs) -> int {
+  if (headless) {
+    throw std::invalid_argument("No window in headless mode, use "
+                                "render_to_file instead of " +
+                                std::string(__func__) + "\n");
+  }
+
+  init_frame();
+  int flag = 1;
+  while ((glfwWindowShouldClose(window) == 0) && (flag != 0)) {
+    if (!on_demand || needs_redraw()) {
+      draw_frame();
+    } else if (data_update_function == nullptr) {
+      glfwWaitEvents();
+    } else {
+      glfwWaitEventsTimeout(IDLE_PERIOD);
+    }
 
+    if (data_update_function != nullptr) {
+      timer.begin(FramePhase::UPDATE);
       flag = data_update_function(fargs);
+      timer.end(FramePhase::UPDATE);
+    }
+  }
+
+  glCheckError();
+  return 0;
+}
+
+auto MeshRender::render_loop_async(
+    int (*simulation_function)(SimulationFrame &frame, void *fargs),
+    void *fargs) -> int {
+  /* The simulation thread publishes its frames in a triple buffer, the
+   * render thread applies the latest one, if any, before each draw.
+   * With on demand rendering, the render thread sleeps until a frame is
+   * published or an event occurs. */
+  if (headless) {
+    throw std::invalid_argument("No window in headless mode, use "
+                                "render_to_file instead of " +
+                                std::string(__func__) + "\n");
+  }
+  TripleBuffer<SimulationFrame> frames;
+  std::atomic<bool> stop{false};
+  std::atomic<bool> finished{false};
+
+  std::thread simulation([&]() {
+    int flag{1};
+    while (flag != 0 && !stop.load()) {
+      SimulationFrame &frame = frames.write_slot();
+      flag = simulation_function(frame, fargs);
+      if (const SimulationFrame *unread = frames.unread_slot()) {
+        frame.merge(*unread);
+      }
+      frames.publish();
+      glfwPostEmptyEvent(); // wakes the render thread
+    }
+    finished.store(true);
+    glfwPostEmptyEvent();
+  });
+
+  try {
+    init_frame();
+    while (glfwWindowShouldClose(window) == 0) {
+      // the frames published before finished was set are seen by update()
+      bool done = finished.load();
+      if (frames.update()) {
+        timer.begin(FramePhase::UPDATE);
+        apply_frame(frames.read_slot());
+        timer.end(FramePhase::UPDATE);
+      } else if (done) {
+        break;
+      }
+
+      if (!on_demand || needs_redraw()) {
+        draw_frame();
+      } else {
+        glfwWaitEvents();
+      }
     }
+  } catch (...) {
+    // e.g. a frame updating a removed object, the simulation is stopped
+    // before the exception leaves
+    stop.store(true);
+    simulation.join();
+    throw;
   }
 
+  stop.store(true);
+  simulation.join();
   glCheckError();
   return 0;
 }
 
+void SimulationFrame::merge(const SimulationFrame &older) {
+  /* The faces come with all the vertices, and with the colors or the
+   * default color, an update with faces replaces the older ones. */
+  for (const FrameObject &old : older.objects) {
+    auto found = std::find_if(
+        objects.begin(), objects.end(),
+        [&](const FrameObject &update) { return update.id == old.id; });
+    if (found == objects.end()) {
+      objects.push_back(old);
+      continue;
+    }
+    if (!found->faces.empty()) {
+      continue;
+    }
+    if (!old.faces.empty()) {
+      found->faces = old.faces;
+    }
+    if (found->vertices.empty()) {
+      found->vertices = old.vertices;
+    }
+    if (found->colors.empty()) {
+      found->colors = old.colors;
+    }
+  }
+}
+
+void MeshRender::apply_frame(const SimulationFrame &frame) {
+  for (const FrameObject &update : frame.objects) {
+    if (!update.faces.empty()) {
+      if (update.colors.empty()) {
+        update_object(update.vertices, update.faces, update.id);
+      } else {
+        update_object(update.vertices, update.faces, update.colors,
+                      update.id);
+      }
+      continue;
+    }
+    if (!update.vertices.empty()) {
+      update_object(update.vertices, update.id);
+    }
+    if (!update.colors.empty()) {
+      update_vertex_colors(update.colors, update.id, 0);
+    }
+  }
+}
+
 void MeshRender::init_frame() const {
   glBindVertexArray(VAO);
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -171,165 +690,504 @@ void MeshRender::init_frame() const {
 }
 
 void MeshRender::draw_frame() {
-
-  glfwGetWindowSize(window, &width, &height);
+  redraw = false;
+  if (!headless) {
+    glfwGetWindowSize(window, &width, &height);
+  }
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  for (auto &obj : objects) {
-    draw(obj);
+  draw_objects();
+  timer.begin(FramePhase::CAPTURE);
+  capture_frame();
+  timer.end(FramePhase::CAPTURE);
+  draw_overlay();
+  timer.end_frame();
+  if (!headless) {
+    glfwSwapBuffers(window);
+    glfwPollEvents();
   }
-  glfwSwapBuffers(window);
-  glfwPollEvents();
 }
 
 auto MeshRender::render_finalize() -> int {
   // Cleanup
+  stop_capture();
+  timer.stop();
+  glDeleteVertexArrays(1, &overlay_VAO);
+  glDeleteBuffers(1, &overlay_VBO);
+  for (Object &obj : objects) {
+    if (obj.stream.id() != 0) {
+      obj.stream.destroy();
+      glDeleteVertexArrays(1, &obj.stream_VAO);
+    }
+    if (obj.instances_VAO != 0) {
+      obj.instances.destroy();
+      glDeleteBuffers(1, &obj.instances_VBO);
+      glDeleteVertexArrays(1, &obj.instances_VAO);
+    }
+  }
   glDeleteVertexArrays(1, &VAO);
   glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &color_VBO);
+  glDeleteBuffers(1, &scalar_VBO);
+  glDeleteBuffers(1, &normal_VBO);
+  glDeleteTextures(1, &colormaps_texture);
   glDeleteBuffers(1, &EBO);
-  glfwTerminate();
+  glDeleteVertexArrays(1, &packed_VAO);
+  glDeleteBuffers(1, &packed_VBO);
+  glDeleteBuffers(1, &packed_color_VBO);
+  glDeleteBuffers(1, &packed_normal_VBO);
+  glDeleteBuffers(1, &indirect_buffer);
+  glDeleteBuffers(1, &objects_SSBO);
+  glDeleteBuffers(1, &camera_UBO);
+  if (headless) {
+    finalize_headless();
+  } else {
+    glfwTerminate();
+  }
   return 0;
 }
 
-void MeshRender::draw(Object &obj) {
-  glUseProgram(obj.shader_program);
-  // Mouse rotation
-  glUniform4f(obj.q_loc, (float)q[0], (float)q[1], (float)q[2], (float)q[3]);
-  glUniform4f(obj.q_inv_loc, (float)q_inv[0], (float)q_inv[1], (float)q_inv[2],
-              (float)q_inv[3]);
-  // Zoom
-  glUniform1f(obj.zoom_loc, (float)zoom_level);
-
-  glUniform2f(obj.viewport_size_loc, (float)width, (float)height);
-
-  switch (obj.object_type) {
-  case ObjectType::AXIS_CROSS:
-  case ObjectType::MESH:
-    glDrawElementsBaseVertex(
-        GL_TRIANGLES, obj.faces_indices_length, GL_UNSIGNED_INT,
-        (void *)(obj.faces_indices_offset * sizeof(unsigned int)),
-        obj.attr_offset / obj.total_number_attr);
-    break;
+void MeshRender::build_draw_commands() {
+  /* Sorts the objects by shader program and vertex format. The objects of
+   * a program and format become one range of indirect commands; a streamed
+   * object has its own range since it is read through its own VAO. The
+   * vectors, which have their own instances buffer, are drawn one by one.
+   * The object transform and the decoding of the packed positions are
+   * combined in the objects data,
+   *   world = scale * position + translation. */
+  std::vector<int> order;
+  for (int id = 0; id < (int)objects.size(); ++id) {
+    if (objects[id].object_type != ObjectType::NONE) {
+      order.push_back(id);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+    const Object &obj_a = objects[a];
+    const Object &obj_b = objects[b];
+    if (obj_a.program_type != obj_b.program_type) {
+      return obj_a.program_type < obj_b.program_type;
+    }
+    if (obj_a.packed != obj_b.packed) {
+      return obj_b.packed;
+    }
+    if (obj_a.short_indices != obj_b.short_indices) {
+      return obj_b.short_indices;
+    }
+    return obj_a.stream.id() == 0 && obj_b.stream.id() != 0;
+  });
+
+  draw_items.clear();
+  draw_commands.clear();
+  command_objects.clear();
+  objects_data.clear();
+  for (int id : order) {
+    const Object &obj = objects[id];
+    if (obj.object_type == ObjectType::VECTOR) {
+      draw_items.push_back({obj.program_type, GL_TRIANGLES,
+                            obj.instances_VAO, obj.index_type(), id, 0, 0});
+      continue;
+    }
+    DrawCommand command;
+    command.count = (unsigned int)obj.faces_indices_length;
+    // in indices, the arena elements hold two short indices
+    command.first_index = (unsigned int)(obj.short_indices
+                                             ? obj.faces_indices_offset * 2
+                                             : obj.faces_indices_offset);
+    if (obj.stream.id() == 0) {
+      command.base_vertex = (int)(obj.attr_offset / obj.total_number_attr);
+    }
 
-  case ObjectType::QUAD_CURVE:
-  case ObjectType::TUBE_CURVE:
-  case ObjectType::SMOOTH_TUBE_CURVE:
-    glDrawElementsBaseVertex(
-        GL_LINES_ADJACENCY, obj.faces_indices_length, GL_UNSIGNED_INT,
-        (void *)(obj.faces_indices_offset * sizeof(unsigned int)),
-        obj.attr_offset / obj.total_number_attr);
-    break;
+    bool streamed = obj.stream.id() != 0;
+    unsigned int vertex_array = streamed     ? obj.stream_VAO
+                                : obj.packed ? packed_VAO
+                                             : VAO;
+    if (!streamed && !draw_items.empty() &&
+        draw_items.back().n_commands > 0 && draw_items.back().id < 0 &&
+        draw_items.back().program_type == obj.program_type &&
+        draw_items.back().vertex_array == vertex_array &&
+        draw_items.back().index_type == obj.index_type()) {
+      ++draw_items.back().n_commands;
+    } else {
+      unsigned int mode = obj.vertices_per_primitive == 4 ? GL_LINES_ADJACENCY
+                                                          : GL_TRIANGLES;
+      draw_items.push_back({obj.program_type, mode, vertex_array,
+                            obj.index_type(), streamed ? id : -1,
+                            (long)draw_commands.size(), 1});
+    }
+    draw_commands.push_back(command);
+    command_objects.push_back(id);
 
-  case ObjectType::VECTOR:
-    glDrawElementsInstancedBaseVertex(
-        GL_TRIANGLES, obj.faces_indices_length, GL_UNSIGNED_INT,
-        (void *)(obj.faces_indices_offset * sizeof(unsigned int)),
-        obj.n_instances, obj.attr_offset / obj.total_number_attr);
+    float scale = obj.transform[3];
+    for (int k = 0; k < 3; ++k) {
+      objects_data.push_back(scale * obj.position_scale[k]);
+    }
+    objects_data.push_back(scale * obj.width);
+    for (int k = 0; k < 3; ++k) {
+      objects_data.push_back(scale * obj.position_offset[k] +
+                             obj.transform[k]);
+    }
+    objects_data.push_back(0);
+    objects_data.insert(objects_data.end(), obj.tint, obj.tint + 3);
+    objects_data.push_back(1);
+
+    // texture coordinate of the scalar, the colormap texels are centered
+    if (obj.colormap < 0) {
+      objects_data.insert(objects_data.end(), {0, 0, -1, 0});
+    } else {
+      double coord_scale = (COLORMAP_SIZE - 1.0) / COLORMAP_SIZE /
+                           (obj.scalar_range[1] - obj.scalar_range[0]);
+      double coord_offset =
+          0.5 / COLORMAP_SIZE - obj.scalar_range[0] * coord_scale;
+      if (obj.packed) {
+        coord_offset += obj.scalar_offset * coord_scale;
+        coord_scale *= obj.scalar_scale;
+      }
+      objects_data.insert(objects_data.end(),
+                          {(float)coord_scale, (float)coord_offset,
+                           (float)obj.colormap, 0});
+    }
+  }
 
-    break;
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER,
+               (long)(draw_commands.size() * sizeof(DrawCommand)),
+               draw_commands.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, objects_SSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               (long)(objects_data.size() * sizeof(float)),
+               objects_data.data(), GL_DYNAMIC_DRAW);
+  draw_commands_outdated = false;
+}
+template <class T>
+void MeshRender::set_bounds(Object &obj, const T *positions,
+                            long int n_vertices) {
+  /* Sphere centered on the axis aligned bounding box, with the radius of
+   * the farthest vertex. The curves are widened by their width. */
+  if (n_vertices == 0) {
+    std::fill(obj.bounds, obj.bounds + 4, 0.0F);
+    return;
+  }
+  double min[3]{positions[0], positions[1], positions[2]};
+  double max[3]{positions[0], positions[1], positions[2]};
+  for (long int i = 1; i < n_vertices; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      min[k] = std::min(min[k], (double)positions[i * 3 + k]);
+      max[k] = std::max(max[k], (double)positions[i * 3 + k]);
+    }
+  }
+  double center[3];
+  for (int k = 0; k < 3; ++k) {
+    center[k] = 0.5 * (min[k] + max[k]);
+  }
+  double radius2{0};
+  for (long int i = 0; i < n_vertices; ++i) {
+    double d2{0};
+    for (int k = 0; k < 3; ++k) {
+      double d = positions[i * 3 + k] - center[k];
+      d2 += d * d;
+    }
+    radius2 = std::max(radius2, d2);
+  }
+  for (int k = 0; k < 3; ++k) {
+    obj.bounds[k] = (float)center[k];
+  }
+  // rounded up, the positions are drawn as floats
+  obj.bounds[3] = (float)(std::sqrt(radius2) * 1.0001 + obj.width);
+}
 
-  default:
-    break;
+auto MeshRender::is_visible(const Object &obj) -> bool {
+  /* Tests the bounding sphere against the view volume of the shaders,
+   *   rotation     p = q * v * q_inv
+   *   perspective  p.xy *= 2 / (2 - p.z), the eye is at (0, 0, 2)
+   *   zoom and aspect ratio, |p.x|, |p.y| <= 1 after projection,
+   *   clipping     p.z in [-1, 1].
+   * The side planes pass through the eye, |x| <= kx * (2 - z). */
+  if (obj.bounds[3] < 0 || obj.object_type == ObjectType::AXIS_CROSS) {
+    return true;
+  }
+  double scale = obj.object_type == ObjectType::VECTOR ? 1 : obj.transform[3];
+  double center[3];
+  for (int k = 0; k < 3; ++k) {
+    center[k] = obj.bounds[k] * scale;
+    if (obj.object_type != ObjectType::VECTOR) {
+      center[k] += obj.transform[k];
+    }
+  }
+  // the I and O keys scale q and q_inv
+  Quaternion p = q * Quaternion(0, center[0], center[1], center[2]) * q_inv;
+  double radius = obj.bounds[3] * scale * q.norm() * q_inv.norm();
+
+  double x = p[1];
+  double y = p[2];
+  double z = p[3];
+  if (z - 1 > radius || -1 - z > radius) {
+    return false;
   }
-};
+  auto inside = [z, radius](double u, double k) {
+    // signed distance to the plane |u| = k * (2 - z)
+    return (std::abs(u) + k * z - 2 * k) / std::sqrt(1 + k * k) <= radius;
+  };
+  return inside(x, (double)width / (2.0 * height * zoom_level)) &&
+         inside(y, 1.0 / (2.0 * zoom_level));
+}
 
-void MeshRender::add_indices(const std::vector<unsigned int> &new_indices) {
-  faces.resize(faces.size() + new_indices.size());
-  std::copy(new_indices.begin(), new_indices.end(),
-            faces.end() - (long int)new_indices.size());
-  resize_EBO();
+void MeshRender::cull_objects() {
+  /* Sets the instance count of the commands, 0 if the object is outside
+   * the view volume; the commands are uploaded only if it changed. */
+  culling_stats = CullingStats();
+  bool changed{false};
+  for (unsigned long i = 0; i < draw_commands.size(); ++i) {
+    const Object &obj = objects[command_objects[i]];
+    bool visible = !culling || is_visible(obj);
+    if (obj.object_type != ObjectType::AXIS_CROSS) {
+      ++culling_stats.n_objects;
+      culling_stats.n_culled += visible ? 0 : 1;
+    }
+    unsigned int instance_count = visible ? 1 : 0;
+    if (draw_commands[i].instance_count != instance_count) {
+      draw_commands[i].instance_count = instance_count;
+      changed = true;
+    }
+  }
+  if (changed) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                    (long)(draw_commands.size() * sizeof(DrawCommand)),
+                    draw_commands.data());
+  }
 }
 
-void MeshRender::update_indices(const std::vector<unsigned int> &new_indices,
-                                Object &obj) {
-  // updates faces
-  std::vector<unsigned int> faces_tmp(faces);
+void MeshRender::update_camera() {
+  /* The view uniforms, shared by all the programs, uploaded once per
+   * frame. */
+  CameraBlock camera{};
+  for (int k = 0; k < 4; ++k) {
+    camera.q[k] = (float)q[k];
+    camera.q_inv[k] = (float)q_inv[k];
+  }
+  camera.viewport_size[0] = (float)width;
+  camera.viewport_size[1] = (float)height;
+  camera.zoom_level = (float)zoom_level;
+  glBindBuffer(GL_UNIFORM_BUFFER, camera_UBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &camera);
+}
 
-  faces.resize(faces.size() +
-               ((long int)new_indices.size() - obj.faces_indices_length));
+void MeshRender::draw_objects() {
+  /* Draws the objects sorted by shader program, each program is bound once
+   * per frame. The objects sharing a program are drawn by a single
+   * glMultiDrawElementsIndirect. */
+  timer.begin(FramePhase::UPLOAD);
+  update_camera();
+  if (draw_commands_outdated) {
+    build_draw_commands();
+  }
+  cull_objects();
+  timer.end(FramePhase::UPLOAD);
+  timer.begin(FramePhase::DRAW);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
 
-  std::copy(new_indices.begin(), new_indices.end(),
-            faces.begin() + (long)obj.faces_indices_offset);
+  const ShaderProgram *current{nullptr};
+  unsigned int vertex_array{VAO};
+  glBindVertexArray(VAO);
+  for (const DrawItem &item : draw_items) {
+    const ShaderProgram &program = programs.at(item.program_type);
+    if (&program != current) {
+      glUseProgram(program.id);
+      current = &program;
+    }
+    // a streamed object VAO is bound with the current region
+    bool streamed = item.n_commands > 0 && item.id >= 0;
+    if (item.vertex_array != vertex_array && !streamed) {
+      glBindVertexArray(item.vertex_array);
+    }
+    vertex_array = item.vertex_array;
+    if (item.n_commands == 0) {
+      Object &obj = objects[item.id];
+      bool visible = !culling || is_visible(obj);
+      ++culling_stats.n_objects;
+      if (visible) {
+        timer.begin_object(item.id);
+        draw(obj);
+        timer.end_object();
+      } else {
+        ++culling_stats.n_culled;
+      }
+      continue;
+    }
 
-  std::copy(faces_tmp.begin() +
-                (long)(obj.faces_indices_offset + obj.faces_indices_length),
-            faces_tmp.end(),
-            faces.begin() +
-                (long)(obj.faces_indices_offset + new_indices.size()));
+    if (streamed) {
+      bind_stream(objects[item.id]);
+    }
+    if (timer.timing_objects()) {
+      draw_each_command(item, program);
+    } else {
+      glUniform1i(program.first_object_loc, (int)item.first_command);
+      glMultiDrawElementsIndirect(
+          item.mode, item.index_type,
+          (void *)(item.first_command * sizeof(DrawCommand)),
+          (int)item.n_commands, 0);
+    }
+    if (streamed) {
+      objects[item.id].stream.fence();
+    }
+  }
+  glBindVertexArray(VAO);
+  timer.end(FramePhase::DRAW);
+}
 
-  obj.faces_indices_length = (long)new_indices.size();
-  resize_EBO();
+void MeshRender::draw_each_command(const DrawItem &item,
+                                   const ShaderProgram &program) {
+  /* Draws the commands of the item one by one, each in its own timer
+   * query; gl_DrawID restarts at 0 for each command. */
+  for (long int i = item.first_command;
+       i < item.first_command + item.n_commands; ++i) {
+    if (draw_commands[i].instance_count == 0) {
+      continue;
+    }
+    timer.begin_object(command_objects[i]);
+    glUniform1i(program.first_object_loc, (int)i);
+    glMultiDrawElementsIndirect(item.mode, item.index_type,
+                                (void *)(i * sizeof(DrawCommand)), 1, 0);
+    timer.end_object();
+  }
 }
 
-void MeshRender::fill_vertice_attr(const std::vector<double> &new_vertices,
-                                   const std::vector<double> &new_colors,
-                                   long int vertices_offset) {
-  // vertices_offset is the global offset in the vector
+void MeshRender::bind_stream(Object &obj) {
+  /* Binds the VAO of a streamed object to the current region, the
+   * streams don't start at the same vertex, the base vertex is 0. */
+  long int base_vertex = obj.attr_offset / obj.total_number_attr;
+  glBindVertexArray(obj.stream_VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, obj.stream.id());
+  glVertexAttribPointer(0, (int)VERT_ATTR_LENGTHS[0], GL_FLOAT, GL_FALSE,
+                        (int)(VERT_ATTR_LENGTHS[0] * sizeof(float)),
+                        (void *)obj.stream.offset());
+  glBindBuffer(GL_ARRAY_BUFFER, color_VBO);
+  glVertexAttribPointer(
+      1, (int)VERT_ATTR_LENGTHS[1], GL_FLOAT, GL_FALSE,
+      (int)(VERT_ATTR_LENGTHS[1] * sizeof(float)),
+      (void *)(base_vertex * VERT_ATTR_LENGTHS[1] * sizeof(float)));
+  glBindBuffer(GL_ARRAY_BUFFER, scalar_VBO);
+  glVertexAttribPointer(
+      2, (int)VERT_ATTR_LENGTHS[2], GL_FLOAT, GL_FALSE,
+      (int)(VERT_ATTR_LENGTHS[2] * sizeof(float)),
+      (void *)(base_vertex * VERT_ATTR_LENGTHS[2] * sizeof(float)));
+  glBindBuffer(GL_ARRAY_BUFFER, normal_VBO);
+  glVertexAttribPointer(
+      3, (int)VERT_ATTR_LENGTHS[3], GL_FLOAT, GL_FALSE,
+      (int)(VERT_ATTR_LENGTHS[3] * sizeof(float)),
+      (void *)(base_vertex * VERT_ATTR_LENGTHS[3] * sizeof(float)));
+}
 
-  long int stride = vertices_stride();
-  long int color_offset = vertices_attr_offset(VertexAttr::COLOR);
+void MeshRender::draw(Object &obj) {
+  /* Draws the instances of a vector object, the other objects are drawn
+   * by indirect commands. */
+  bind_instances(obj);
+  glDrawElementsInstancedBaseVertex(
+      GL_TRIANGLES, obj.faces_indices_length, obj.index_type(),
+      (void *)(obj.faces_indices_offset * sizeof(unsigned int)),
+      obj.n_instances, obj.attr_offset / obj.total_number_attr);
+  if (obj.instances.id() != 0) {
+    obj.instances.fence();
+  }
+}
 
-  if (new_colors.size() == new_vertices.size()) {
-    for (long int i = 0; i < (long)new_vertices.size() / 3; ++i) {
-      for (long int j = 0; j < 3; ++j) {
-        vertices_attr.at(vertices_offset + i * stride + j) =
-            (float)new_vertices.at(i * 3 + j);
-        vertices_attr.at(vertices_offset + i * stride + color_offset + j) =
-            (float)new_colors.at(i * 3 + j);
-      }
-    }
-  } else if (new_colors.size() == 3) {
-    for (long int i = 0; i < (long)new_vertices.size() / 3; ++i) {
-      for (long int j = 0; j < 3; ++j) {
-        vertices_attr.at(vertices_offset + i * stride + j) =
-            (float)new_vertices.at(i * 3 + j);
-        vertices_attr.at(vertices_offset + i * stride + color_offset + j) =
-            (float)new_colors.at(j);
-      }
-    }
+void MeshRender::update_indices(const std::vector<unsigned int> &new_indices,
+                                Object &obj) {
+  /* Replaces the indices of an object, only its range is uploaded. The
+   * index type follows the new indices. */
+  long int old_units = obj.indices_units();
+  obj.short_indices = fits_short(new_indices);
+  obj.faces_indices_length = (long int)new_indices.size();
+  obj.faces_indices_offset = indices_arena.resize(
+      obj.faces_indices_offset, old_units, obj.indices_units());
+  write_indices(new_indices, obj);
+  draw_commands_outdated = true;
+}
+
+void MeshRender::write_indices(const std::vector<unsigned int> &indices,
+                               const Object &obj) {
+  // writes and uploads the object range in its index type
+  unsigned int *host = indices_arena.host(obj.faces_indices_offset);
+  if (obj.short_indices) {
+    std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+    std::memcpy(host, short_indices.data(),
+                short_indices.size() * sizeof(uint16_t));
   } else {
+    std::copy(indices.begin(), indices.end(), host);
+  }
+  indices_arena.upload(obj.faces_indices_offset, obj.indices_units());
+}
+
+void MeshRender::fill_vertice_attr(const std::vector<double> &new_vertices,
+                                   const std::vector<double> &new_colors,
+                                   Object &obj) {
+  /* Writes the host copy of the object range, in the object format.
+   * new_colors has one color per vertex or a single color. */
+  if (new_colors.size() != new_vertices.size() && new_colors.size() != 3) {
     throw std::invalid_argument(
         "New vertices size and colors size don't match in " +
         std::string(__func__) + "\n");
   }
-}
-
-void MeshRender::add_vertices(const std::vector<double> &new_vertices,
-                              const std::vector<double> &colors) {
-
-  long int stride = vertices_stride();
-  long int n_curent_vertices = n_vertices();
-
-  vertices_attr.resize(vertices_attr.size() +
-                       (new_vertices.size() / 3) * stride);
-
-  fill_vertice_attr(new_vertices, colors, n_curent_vertices * stride);
+  long int vertices_offset = obj.attr_offset / obj.total_number_attr;
+  auto n_vertices = (long int)new_vertices.size() / 3;
+  long int color_stride = new_colors.size() == 3 ? 0 : 3;
+
+  if (obj.packed) {
+    pack_positions(obj, new_vertices.data(), n_vertices);
+    uint8_t *colors = packed_colors_arena.host(vertices_offset);
+    for (long int i = 0; i < n_vertices; ++i) {
+      for (long int j = 0; j < 3; ++j) {
+        colors[i * 4 + j] = color_byte(new_colors[i * color_stride + j]);
+      }
+      colors[i * 4 + 3] = UINT8_MAX;
+    }
+    return;
+  }
 
-  resize_VBO();
+  float *positions = vertices_arena.host(vertices_offset);
+  float *colors = colors_arena.host(vertices_offset);
+  std::copy(new_vertices.begin(), new_vertices.end(), positions);
+  for (long int i = 0; i < n_vertices; ++i) {
+    for (long int j = 0; j < 3; ++j) {
+      colors[i * 3 + j] = (float)new_colors[i * color_stride + j];
+    }
+  }
 }
 
 void MeshRender::update_vertices(const std::vector<double> &new_vertices,
                                  const std::vector<double> &colors,
                                  Object &obj) {
-
-  // update vertices, can change the number of vertices.
-  std::vector<float> attr_tmp(vertices_attr);
-  long int new_attr_length = vertices_stride() * (long)new_vertices.size() / 3;
-
-  vertices_attr.resize(vertices_attr.size() +
-                       (new_attr_length - obj.attr_length));
-
-  fill_vertice_attr(new_vertices, colors, obj.attr_offset);
-
-  std::copy(attr_tmp.begin() + (long)(obj.attr_offset + obj.attr_length),
-            attr_tmp.end(),
-            vertices_attr.begin() + (long)(obj.attr_offset + new_attr_length));
-
-  obj.attr_length = new_attr_length;
-
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, (long)(vertices_attr.size() * sizeof(float)),
-               vertices_attr.data(), GL_STATIC_DRAW);
+  /* Updates the vertices, can change the number of vertices.
+   * Only the object range is uploaded. */
+  long int stride = obj.total_number_attr;
+  long int old_n_vertices = obj.n_vertices();
+  auto new_n_vertices = (long int)new_vertices.size() / 3;
+  long int offset = resize_vertices(obj.attr_offset / stride, old_n_vertices,
+                                    new_n_vertices, obj.packed);
+  obj.attr_offset = offset * stride;
+  obj.attr_length = new_n_vertices * stride;
+
+  fill_vertice_attr(new_vertices, colors, obj);
+
+  obj.bvh_outdated = true;
+  obj.bvh_faces_outdated = true;
+  draw_commands_outdated = true;
+  set_bounds(obj, new_vertices.data(), new_n_vertices);
+
+  if (obj.packed) {
+    packed_vertices_arena.upload(offset, new_n_vertices);
+    packed_colors_arena.upload(offset, new_n_vertices);
+    return;
+  }
+  colors_arena.upload(offset, new_n_vertices);
+  if (obj.stream.id() == 0) {
+    vertices_arena.upload(offset, new_n_vertices);
+  } else if (new_n_vertices == old_n_vertices) {
+    stream_positions(obj);
+  } else {
+    obj.stream.destroy();
+    init_stream(obj);
+  }
 }
 
 MeshRender::Object::Object(ObjectType type, long int attr_offset,
@@ -340,25 +1198,45 @@ MeshRender::Object::Object(ObjectType type, long int attr_offset,
       total_number_attr(total_number_attr),
       faces_indices_offset(indices_offset),
       faces_indices_length(indices_length),
-      vertices_per_primitive(vertices_per_primitive) {
-  set_shader_program();
-}
+      vertices_per_primitive(vertices_per_primitive),
+      program_type(OBJECT_SHADER_MAP.at(type)) {}
 
 void MeshRender::update_object(const std::vector<double> &ivertices, int id) {
   /* Update the vertices positions of an object. */
-  Object &obj = objects.at(id);
+  Object &obj = live_object(id);
+  if (ivertices.size() < (unsigned long)obj.n_vertices() * 3) {
+    throw std::invalid_argument("Not enough vertices in " +
+                                std::string(__func__) + "\n");
+  }
 
+  if (obj.stream.id() != 0) {
+    float *positions = map_vertices(id);
+    for (long int i = 0; i < obj.attr_length; ++i) {
+      positions[i] = (float)ivertices[i];
+    }
+    set_bounds(obj, ivertices.data(), obj.n_vertices());
+    return;
+  }
+  long int offset = obj.attr_offset / obj.total_number_attr;
+  obj.bvh_outdated = true;
+  set_bounds(obj, ivertices.data(), obj.n_vertices());
+  redraw = true;
+
+  if (obj.packed) {
+    // the bounding box, hence the decoding, can change
+    pack_positions(obj, ivertices.data(), obj.n_vertices());
+    packed_vertices_arena.upload(offset, obj.n_vertices());
+    draw_commands_outdated = true;
+    return;
+  }
+  float *vertices_attr = vertices_arena.host(offset);
   for (unsigned int i = 0; i < obj.n_vertices(); ++i) {
     for (unsigned int j = 0; j < 3; ++j) {
-      vertices_attr.at(obj.attr_offset + i * obj.total_number_attr + j) =
-          (float)ivertices.at(i * 3 + j);
+      vertices_attr[i * obj.total_number_attr + j] =
+          (float)ivertices[i * 3 + j];
     }
   }
-
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferSubData(GL_ARRAY_BUFFER, (long)sizeof(float) * obj.attr_offset,
-                  (long)sizeof(float) * obj.attr_length,
-                  vertices_attr.data() + obj.attr_offset);
+  vertices_arena.upload(offset, obj.n_vertices());
 }
 
 void MeshRender::update_object(const std::vector<double> &ivertices,
@@ -366,7 +1244,7 @@ void MeshRender::update_object(const std::vector<double> &ivertices,
                                int id) {
   /* TODO rename the ubdate_object as ubdate_trimesh */
   /* Update the vertices and faces of an object. */
-  Object &obj = objects.at(id);
+  Object &obj = live_object(id);
 
   // updates faces
   update_indices(ifaces, obj);
@@ -386,7 +1264,7 @@ void MeshRender::update_object(const std::vector<double> &ivertices,
         std::string(__func__) + "\n");
   }
   /* Update the vertices and faces of an object. */
-  Object &obj = objects.at(id);
+  Object &obj = live_object(id);
 
   // updates faces
   update_indices(ifaces, obj);
@@ -401,19 +1279,31 @@ auto MeshRender::add_object(const std::vector<double> &ivertices,
                             const std::vector<double> &colors,
                             ObjectType object_type) -> int {
 
-  auto attr_offset = (long int)vertices_attr.size();
-  auto attr_length = (long int)ivertices.size() * 2;
-  auto faces_indices_offset = (long int)faces.size();
+  /* Allocates the object in the buffers, the space freed by the removed
+   * objects is reused first. */
+  long int stride = vertices_stride();
+  auto n_new_vertices = (long int)ivertices.size() / 3;
   auto faces_indices_length = (long int)ifaces.size();
-
-  Object new_obj(object_type, attr_offset, attr_length, vertices_stride(),
-                 faces_indices_offset, faces_indices_length,
+  bool short_indices = fits_short(ifaces);
+  long int vertices_offset = allocate_vertices(n_new_vertices, false);
+  long int faces_indices_offset = indices_arena.allocate(
+      short_indices ? (faces_indices_length + 1) / 2 : faces_indices_length);
+
+  Object new_obj(object_type, vertices_offset * stride,
+                 n_new_vertices * stride, stride, faces_indices_offset,
+                 faces_indices_length,
                  OBJECT_VERTICES_PER_PRIMITIVE_MAP.at(object_type));
 
-  add_indices(ifaces);
-  add_vertices(ivertices, colors);
+  new_obj.short_indices = short_indices;
+  write_indices(ifaces, new_obj);
+  fill_vertice_attr(ivertices, colors, new_obj);
+  vertices_arena.upload(vertices_offset, n_new_vertices);
+  colors_arena.upload(vertices_offset, n_new_vertices);
+  set_bounds(new_obj, ivertices.data(), n_new_vertices);
 
+  get_program(new_obj.program_type);
   objects.push_back(new_obj);
+  draw_commands_outdated = true;
   return (int)objects.size() - 1;
 }
 
@@ -429,41 +1319,201 @@ auto MeshRender::add_mesh(const std::vector<double> &ivertices,
   return add_object(ivertices, ifaces, DEFAULT_COLOR, ObjectType::MESH);
 }
 
-void MeshRender::fill_vectors_instance_attr(
-    const std::vector<double> &coords, const std::vector<double> &directions,
-    const std::vector<double> &colors, std::vector<float> &instances_attr) {
-
-  instances_attr.resize(coords.size() * 3);
-  if (colors.size() == coords.size()) {
-    for (int i = 0; i < (int)coords.size(); i += 3) {
-      instances_attr.at(i * 3) = (float)coords.at(i);
-      instances_attr.at(i * 3 + 1) = (float)coords.at(i + 1);
-      instances_attr.at(i * 3 + 2) = (float)coords.at(i + 2);
-
-      instances_attr.at(i * 3 + 3) = (float)directions.at(i);
-      instances_attr.at(i * 3 + 4) = (float)directions.at(i + 1);
-      instances_attr.at(i * 3 + 5) = (float)directions.at(i + 2);
+static auto half_float(double value) -> uint16_t {
+  /* Rounds to the nearest half float, the values too small for a normal
+   * half float are flushed to zero and the overflows become infinite. */
+  auto single = (float)value;
+  uint32_t bits{0};
+  std::memcpy(&bits, &single, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+  uint32_t mantissa = bits & 0x7FFFFF;
+  if (exponent <= 0) {
+    return (uint16_t)sign;
+  }
+  if (exponent >= 31) {
+    return (uint16_t)(sign | 0x7C00);
+  }
+  uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+  // ties to even, a carry increments the exponent
+  uint32_t rest = mantissa & 0x1FFF;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0)) {
+    ++half;
+  }
+  return (uint16_t)half;
+}
 
-      instances_attr.at(i * 3 + 6) = (float)colors.at(i);
-      instances_attr.at(i * 3 + 7) = (float)colors.at(i + 1);
-      instances_attr.at(i * 3 + 8) = (float)colors.at(i + 2);
+static void fill_instances(const std::vector<double> &coords,
+                           const std::vector<double> &directions,
+                           const std::vector<double> &colors, bool half,
+                           char *instances, float *bounds) {
+  /* Interleaved attributes of each vector, the vectors are split between
+   * threads. The colors are either one color per vector or a single color.
+   * The bounding sphere encloses the box of the vectors origins, widened
+   * by the longest vector; the vector instance is scaled by the vector
+   * length. */
+  bool single_color = colors.size() == 3 && coords.size() != 3;
+  auto n = (long int)coords.size() / 3;
+  int n_chunks = Parallel::n_chunks(n);
+  // min x, y, z, max x, y, z and squared length of each chunk
+  std::vector<double> chunk_bounds(n_chunks * 7);
+  Parallel::for_chunks(n, n_chunks, [&](long int begin, long int end,
+                                        int chunk) {
+    double *box = &chunk_bounds[chunk * 7];
+    for (int k = 0; k < 3; ++k) {
+      box[k] = begin < end ? coords[begin * 3 + k] : 0;
+      box[3 + k] = box[k];
+    }
+    box[6] = 0;
+    for (long int i = begin; i < end; ++i) {
+      const double *color = single_color ? colors.data() : &colors[i * 3];
+      const double *coord = &coords[i * 3];
+      const double *direction = &directions[i * 3];
+      for (int k = 0; k < 3; ++k) {
+        box[k] = std::min(box[k], coord[k]);
+        box[3 + k] = std::max(box[3 + k], coord[k]);
+      }
+      box[6] = std::max(box[6], direction[0] * direction[0] +
+                                    direction[1] * direction[1] +
+                                    direction[2] * direction[2]);
+      if (half) {
+        auto *attr = (uint16_t *)(instances + i * PACKED_INSTANCE_SIZE);
+        for (int k = 0; k < 3; ++k) {
+          attr[k] = half_float(coord[k]);
+          attr[4 + k] = half_float(direction[k]);
+        }
+        attr[3] = 0;
+        attr[7] = 0;
+        auto *rgba = (uint8_t *)(attr + 8);
+        for (int k = 0; k < 3; ++k) {
+          rgba[k] = color_byte(color[k]);
+        }
+        rgba[3] = UINT8_MAX;
+      } else {
+        auto *attr = (float *)(instances + i * INSTANCE_SIZE);
+        for (int k = 0; k < 3; ++k) {
+          attr[k] = (float)coord[k];
+          attr[3 + k] = (float)direction[k];
+          attr[6 + k] = (float)color[k];
+        }
+      }
+    }
+  });
+
+  double extent{0};
+  const std::vector<double> &instance =
+      VectorInstance::vector_instance_vertices;
+  for (unsigned long i = 0; i < instance.size(); i += 3) {
+    extent = std::max(extent, std::sqrt(instance[i] * instance[i] +
+                                        instance[i + 1] * instance[i + 1] +
+                                        instance[i + 2] * instance[i + 2]));
+  }
+  double *box = chunk_bounds.data();
+  for (int chunk = 1; chunk < n_chunks; ++chunk) {
+    const double *chunk_box = &chunk_bounds[chunk * 7];
+    for (int k = 0; k < 3; ++k) {
+      box[k] = std::min(box[k], chunk_box[k]);
+      box[3 + k] = std::max(box[3 + k], chunk_box[3 + k]);
     }
-  } else if (colors.size() == 3) {
+    box[6] = std::max(box[6], chunk_box[6]);
+  }
+  double half_diagonal2{0};
+  for (int k = 0; k < 3; ++k) {
+    bounds[k] = (float)((box[k] + box[3 + k]) / 2);
+    half_diagonal2 += (box[3 + k] - box[k]) * (box[3 + k] - box[k]) / 4;
+  }
+  bounds[3] = (float)((std::sqrt(half_diagonal2) +
+                       std::sqrt(box[6]) * extent) *
+                      1.0001);
+}
 
-    for (int i = 0; i < (int)coords.size(); i += 3) {
-      instances_attr.at(i * 3) = (float)coords.at(i);
-      instances_attr.at(i * 3 + 1) = (float)coords.at(i + 1);
-      instances_attr.at(i * 3 + 2) = (float)coords.at(i + 2);
+void MeshRender::write_instances(Object &obj,
+                                 const std::vector<double> &coords,
+                                 const std::vector<double> &directions,
+                                 const std::vector<double> &colors) {
+  /* Writes the vectors in the next region of the instances stream, the
+   * stream is only reallocated when it grows. Without openGL 4.4, the
+   * instances buffer is orphaned and refilled. */
+  if (directions.size() != coords.size() ||
+      (colors.size() != coords.size() && colors.size() != 3)) {
+    throw std::invalid_argument(
+        "Coords, directions and colors sizes don't match in " +
+        std::string(__func__) + "\n");
+  }
+  obj.n_instances = (int)coords.size() / 3;
+  long int size = obj.n_instances * (obj.half_instances ? PACKED_INSTANCE_SIZE
+                                                        : INSTANCE_SIZE);
+  if (StreamBuffer::supported()) {
+    if (obj.instances.id() == 0 || obj.instances.size() < size) {
+      obj.instances.destroy();
+      obj.instances.init(size);
+    }
+    fill_instances(coords, directions, colors, obj.half_instances,
+                   (char *)obj.instances.next_region(), obj.bounds);
+    return;
+  }
+  std::vector<char> instances(size);
+  fill_instances(coords, directions, colors, obj.half_instances,
+                 instances.data(), obj.bounds);
+  if (obj.instances_VBO == 0) {
+    glGenBuffers(1, &obj.instances_VBO);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, obj.instances_VBO);
+  glBufferData(GL_ARRAY_BUFFER, size, instances.data(), GL_STREAM_DRAW);
+}
 
-      instances_attr.at(i * 3 + 3) = (float)directions.at(i);
-      instances_attr.at(i * 3 + 4) = (float)directions.at(i + 1);
-      instances_attr.at(i * 3 + 5) = (float)directions.at(i + 2);
+void MeshRender::bind_instances(Object &obj) {
+  /* Points the instances attributes to the current region, the vector
+   * VAO has to be bound. */
+  bool streamed = obj.instances.id() != 0;
+  glBindBuffer(GL_ARRAY_BUFFER,
+               streamed ? obj.instances.id() : obj.instances_VBO);
+  long int offset = streamed ? obj.instances.offset() : 0;
+  if (obj.half_instances) {
+    glVertexAttribPointer(2, 3, GL_HALF_FLOAT, GL_FALSE, PACKED_INSTANCE_SIZE,
+                          (void *)offset);
+    glVertexAttribPointer(3, 3, GL_HALF_FLOAT, GL_FALSE, PACKED_INSTANCE_SIZE,
+                          (void *)(offset + 4 * sizeof(uint16_t)));
+    glVertexAttribPointer(4, 3, GL_UNSIGNED_BYTE, GL_TRUE,
+                          PACKED_INSTANCE_SIZE,
+                          (void *)(offset + 8 * sizeof(uint16_t)));
+    return;
+  }
+  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, INSTANCE_SIZE,
+                        (void *)offset);
+  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, INSTANCE_SIZE,
+                        (void *)(offset + 3 * sizeof(float)));
+  glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, INSTANCE_SIZE,
+                        (void *)(offset + 6 * sizeof(float)));
+}
 
-      instances_attr.at(i * 3 + 6) = (float)colors.at(0);
-      instances_attr.at(i * 3 + 7) = (float)colors.at(1);
-      instances_attr.at(i * 3 + 8) = (float)colors.at(2);
+void MeshRender::pack_instances(Object &obj) {
+  /* Reads back the last written vectors and rewrites them in the packed
+   * layout. */
+  if (obj.half_instances) {
+    return;
+  }
+  long int n = obj.n_instances;
+  std::vector<float> attr(n * 9);
+  if (obj.instances.id() != 0) {
+    std::memcpy(attr.data(), obj.instances.data(), n * INSTANCE_SIZE);
+  } else {
+    glBindBuffer(GL_ARRAY_BUFFER, obj.instances_VBO);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, n * INSTANCE_SIZE, attr.data());
+  }
+  std::vector<double> coords(n * 3);
+  std::vector<double> directions(n * 3);
+  std::vector<double> colors(n * 3);
+  for (long int i = 0; i < n; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      coords[i * 3 + k] = attr[i * 9 + k];
+      directions[i * 3 + k] = attr[i * 9 + 3 + k];
+      colors[i * 3 + k] = attr[i * 9 + 6 + k];
     }
   }
+  obj.half_instances = true;
+  write_instances(obj, coords, directions, colors);
+  redraw = true;
 }
 
 auto MeshRender::add_vectors(const std::vector<double> &coords,
@@ -476,55 +1526,74 @@ auto MeshRender::add_vectors(const std::vector<double> &coords,
                           ObjectType::VECTOR);
 
   Object &obj = objects.at(obj_id);
-  obj.n_instances = (int)coords.size() / 3;
-
-  std::vector<float> instances_attr;
-
-  fill_vectors_instance_attr(coords, directions, colors, instances_attr);
-
-  unsigned int vector_VBO{0};
-  glGenBuffers(1, &vector_VBO);
-  glBindBuffer(GL_ARRAY_BUFFER, vector_VBO);
-  glBufferData(GL_ARRAY_BUFFER,
-               (long)sizeof(float) * (long)instances_attr.size(),
-               instances_attr.data(), GL_STATIC_DRAW);
-
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float), (void *)0);
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float),
-                        (void *)(3 * sizeof(float)));
-  glEnableVertexAttribArray(3);
 
-  glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(float),
-                        (void *)(6 * sizeof(float)));
-  glEnableVertexAttribArray(4);
-
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glVertexAttribDivisor(2, 1);
-  glVertexAttribDivisor(3, 1);
-  glVertexAttribDivisor(4, 1);
+  // the vertices are read from the shared streams, and the instances
+  // attributes from the buffer of the object, set at each draw
+  glGenVertexArrays(1, &obj.instances_VAO);
+  glBindVertexArray(obj.instances_VAO);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glVertexAttribPointer(0, (int)VERT_ATTR_LENGTHS[0], GL_FLOAT, GL_FALSE,
+                        (int)(VERT_ATTR_LENGTHS[0] * sizeof(float)),
+                        (void *)0);
+  glEnableVertexAttribArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, color_VBO);
+  glVertexAttribPointer(1, (int)VERT_ATTR_LENGTHS[1], GL_FLOAT, GL_FALSE,
+                        (int)(VERT_ATTR_LENGTHS[1] * sizeof(float)),
+                        (void *)0);
+  glEnableVertexAttribArray(1);
+  for (int i = 2; i < 5; ++i) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribDivisor(i, 1);
+  }
+  glBindVertexArray(VAO);
 
+  write_instances(obj, coords, directions, colors);
   return obj_id;
 }
 
+void MeshRender::update_vectors(int id, const std::vector<double> &coords,
+                                const std::vector<double> &directions,
+                                const std::vector<double> &colors) {
+  Object &obj = live_object(id);
+  if (obj.object_type != ObjectType::VECTOR) {
+    throw std::invalid_argument("The object is not a vector object in " +
+                                std::string(__func__) + "\n");
+  }
+  write_instances(obj, coords, directions, colors);
+  redraw = true;
+}
+
 auto MeshRender::add_vectors(const std::vector<double> &coords,
                              const std::vector<double> &directions) -> int {
   // Draws a set of vectors or a single vector
   return add_vectors(coords, directions, DEFAULT_COLOR);
 }
 
-static auto get_gost_point(const double *point0,
-                           const double *point1) -> std::vector<double> {
-  // Create a point just before point0, almost aligned with point 0 and 1.
+static void get_gost_point(const double *point0, const double *point1,
+                           double *gost_point) {
+  // Writes a point just before point0, almost aligned with point 0 and 1.
   // this function exist for open curves since we need adjacency.
-
-  auto tangent = Linalg::vect_sub(point0, point1);
-  tangent = Linalg::normalize(tangent);
-  auto normal = Linalg::normal(tangent.data());
-  normal = Linalg::vect_scal_mult(normal.data(), 0.01);
-  tangent = Linalg::vect_add(tangent.data(), normal.data());
-  tangent = Linalg::vect_scal_mult(tangent.data(), 0.1);
-  return Linalg::vect_add(point0, tangent.data());
+  double tangent[3];
+  for (int k = 0; k < 3; ++k) {
+    tangent[k] = point0[k] - point1[k];
+  }
+  double inv_norm = 1.0 / Linalg::norm(tangent);
+  for (int k = 0; k < 3; ++k) {
+    tangent[k] *= inv_norm;
+  }
+  // normal to the tangent, as Linalg::normal
+  inv_norm = 1.0 / Linalg::norm(tangent);
+  double t0 = tangent[0] * inv_norm;
+  double t1 = tangent[1] * inv_norm;
+  double normal[3]{1, 0, 0};
+  if (std::abs(t0) > 1e-6 || std::abs(t1) > 1e-6) {
+    normal[0] = -t1;
+    normal[1] = t0;
+  }
+  for (int k = 0; k < 3; ++k) {
+    gost_point[k] = point0[k] + (tangent[k] + normal[k] * 0.01) * 0.1;
+  }
 }
 
 auto curvetype_to_objecttype(CurveType type) {
@@ -548,48 +1617,82 @@ auto MeshRender::add_curve(const std::vector<double> &coords,
                            const std::vector<double> &colors, CurveType type,
                            double width) -> int {
   // Adds a curve object, generate gost points at the extremities.
+  return add_curves(coords, colors,
+                    std::vector<long int>{0, (long int)coords.size() / 3},
+                    type, width);
+}
 
-  ObjectType obtype = curvetype_to_objecttype(type);
-
-  std::vector<double> coords_clean(coords.size() + 6);
-  std::copy(coords.begin(), coords.end(), coords_clean.begin() + 3);
-
-  auto gost_point = get_gost_point(coords.data(), &coords[3]);
-  std::copy(gost_point.begin(), gost_point.end(), coords_clean.begin());
-
-  gost_point =
-      get_gost_point(&coords[coords.size() - 3], &coords[coords.size() - 6]);
-  std::copy(gost_point.begin(), gost_point.end(), coords_clean.end() - 3);
-
-  std::vector<unsigned int> curve_indices(4 * (coords_clean.size() / 3 - 3));
-  for (unsigned int i = 0; i < curve_indices.size() / 4; ++i) {
-    curve_indices.at(i * 4) = i;
-    curve_indices.at(i * 4 + 1) = i + 1;
-    curve_indices.at(i * 4 + 2) = i + 2;
-    curve_indices.at(i * 4 + 3) = i + 3;
+void MeshRender::check_curves(const std::vector<double> &coords,
+                              const std::vector<double> &colors,
+                              const std::vector<long int> &curves_offsets) {
+  auto n_curves = (long int)curves_offsets.size() - 1;
+  if (n_curves < 1 || curves_offsets.front() != 0 ||
+      curves_offsets.back() != (long int)coords.size() / 3) {
+    throw std::invalid_argument("Curves offsets don't match the coords in " +
+                                std::string(__func__) + "\n");
   }
-
-  int obj_id{0};
-  std::vector<double> per_point_color(coords_clean.size());
-  if (colors.size() == 3) {
-    for (int i = 0; i < (int)coords_clean.size(); i += 3) {
-      per_point_color.at(i) = colors[0];
-      per_point_color.at(i + 1) = colors[1];
-      per_point_color.at(i + 2) = colors[2];
-    }
-    obj_id = add_object(coords_clean, curve_indices, per_point_color, obtype);
-  } else if (colors.size() == coords.size()) {
-    std::copy(colors.begin(), colors.end(), per_point_color.begin() + 3);
-    obj_id = add_object(coords_clean, curve_indices, per_point_color, obtype);
-  } else {
+  if (colors.size() != coords.size() && colors.size() != 3) {
     throw std::invalid_argument("Coords size and colors size don't match in " +
                                 std::string(__func__) + "\n");
   }
+  for (long int c = 0; c < n_curves; ++c) {
+    if (curves_offsets[c + 1] - curves_offsets[c] < 2) {
+      throw std::invalid_argument("A curve needs at least 2 points in " +
+                                  std::string(__func__) + "\n");
+    }
+  }
+}
+
+auto MeshRender::add_curves(const std::vector<double> &coords,
+                            const std::vector<double> &colors,
+                            const std::vector<long int> &curves_offsets,
+                            CurveType type, double width) -> int {
+  /* The curve c is stored from the vertex curves_offsets[c] + 2 c, with a
+   * gost point at each end, and its segments from the primitive
+   * curves_offsets[c] - c. Each curve is written at its offsets, the
+   * curves are processed in parallel and the object is uploaded once. */
+  if (type == CurveType::EXTRUDED_TUBE) {
+    return add_tubes(coords, colors, curves_offsets, width);
+  }
+  check_curves(coords, colors, curves_offsets);
+  auto n_points = (long int)coords.size() / 3;
+  auto n_curves = (long int)curves_offsets.size() - 1;
+
+  std::vector<double> vertices((n_points + 2 * n_curves) * 3);
+  std::vector<double> vertex_colors(vertices.size());
+  std::vector<unsigned int> indices((n_points - n_curves) * 4);
+  Parallel::for_each_range(curves_offsets, [&](long int c) {
+    long int first = curves_offsets[c];
+    long int n = curves_offsets[c + 1] - first;
+    long int first_vertex = first + 2 * c;
+    double *curve = &vertices[first_vertex * 3];
+    std::copy(&coords[first * 3], &coords[(first + n) * 3], curve + 3);
+    get_gost_point(curve + 3, curve + 6, curve);
+    get_gost_point(curve + n * 3, curve + (n - 1) * 3, curve + (n + 1) * 3);
+
+    // the gost points take the colors of the ends
+    double *curve_colors = &vertex_colors[first_vertex * 3];
+    for (long int i = 0; i < n + 2; ++i) {
+      long int point =
+          colors.size() == 3 ? 0 : first + std::clamp(i - 1, 0L, n - 1);
+      std::copy(&colors[point * 3], &colors[point * 3] + 3,
+                curve_colors + i * 3);
+    }
+
+    unsigned int *quad = &indices[(first - c) * 4];
+    for (long int i = 0; i < n - 1; ++i) {
+      for (int k = 0; k < 4; ++k) {
+        quad[i * 4 + k] = (unsigned int)(first_vertex + i + k);
+      }
+    }
+  });
 
+  int obj_id = add_object(vertices, indices, vertex_colors,
+                          curvetype_to_objecttype(type));
   Object &obj = objects.at(obj_id);
   obj.vertices_per_primitive = 4; // for line adjacency
-  glUniform1f(glGetUniformLocation(obj.shader_program, "r"), (float)width);
-
+  obj.width = (float)width;
+  obj.bounds[3] += obj.width;
   return obj_id;
 }
 
@@ -600,6 +1703,9 @@ auto MeshRender::add_curves(const std::vector<double> &coords,
   // Draws multiples curves. Indices are for example:
   // [0, 1, 2, 3, |  1, 2, 3, 4, | 2, 3, 4, 5] In the order they are feeded to
   // the GPU
+  if (type == CurveType::EXTRUDED_TUBE) {
+    return add_adjacency_tubes(coords, colors, curves_indices, width);
+  }
 
   ObjectType obtype = curvetype_to_objecttype(type);
 
@@ -620,7 +1726,8 @@ auto MeshRender::add_curves(const std::vector<double> &coords,
   }
 
   Object &obj = objects.at(obj_id);
-  glUniform1f(glGetUniformLocation(obj.shader_program, "r"), (float)width);
+  obj.width = (float)width;
+  obj.bounds[3] += obj.width;
 
   return obj_id;
 }
@@ -628,30 +1735,318 @@ auto MeshRender::add_curves(const std::vector<double> &coords,
 void MeshRender::update_vertex_colors(std::vector<double> &colors,
                                       unsigned int object_idx) {
 
-  size_t n_vertice_attr = vertices_stride();
-
-  Object &obj = objects.at(object_idx);
+  Object &obj = live_object((int)object_idx);
 
   if ((int)colors.size() / 3 != obj.n_vertices()) {
     throw std::invalid_argument(
         "Vertices size and colors size don't match in " +
         std::string(__func__) + "\n");
   }
+  update_vertex_colors(colors, object_idx, 0);
+}
 
-  for (long int i = 0; i < obj.n_vertices(); ++i) {
-    for (long int j = 0; j < 3; ++j) {
-      // copies the precedent attributes
-      vertices_attr.at(obj.attr_offset + i * n_vertice_attr + n_vertice_attr -
-                       3 + j) = (float)colors.at(i * 3 + j);
+void MeshRender::update_vertex_colors(const std::vector<double> &colors,
+                                      unsigned int object_idx,
+                                      long int first_vertex) {
+  /* Only the colors stream is modified, and only on the given range. */
+  Object &obj = live_object((int)object_idx);
+  auto n_colors = (long int)colors.size() / 3;
+
+  if (first_vertex < 0 || first_vertex + n_colors > obj.n_vertices()) {
+    throw std::invalid_argument("Colors range out of the object vertices in " +
+                                std::string(__func__) + "\n");
+  }
+
+  long int offset = obj.attr_offset / obj.total_number_attr + first_vertex;
+  redraw = true;
+  if (obj.packed) {
+    uint8_t *packed_colors = packed_colors_arena.host(offset);
+    for (long int i = 0; i < n_colors; ++i) {
+      for (int k = 0; k < 3; ++k) {
+        packed_colors[i * 4 + k] = color_byte(colors[i * 3 + k]);
+      }
     }
+    packed_colors_arena.upload(offset, n_colors);
+    return;
   }
+  std::copy(colors.begin(), colors.begin() + n_colors * 3,
+            colors_arena.host(offset));
+  colors_arena.upload(offset, n_colors);
+}
 
-  glBindVertexArray(VAO);
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  // TODO do not reload all data
-  glBufferData(GL_ARRAY_BUFFER,
-               (long)vertices_attr.size() * (long)sizeof(float),
-               vertices_attr.data(), GL_STATIC_DRAW);
+auto MeshRender::add_mesh(const std::vector<double> &ivertices,
+                          const std::vector<unsigned int> &ifaces,
+                          const std::vector<double> &scalars,
+                          const std::vector<double> &colormap, double min,
+                          double max) -> int {
+  if ((long)scalars.size() * 3 != (long)ivertices.size()) {
+    throw std::invalid_argument("One scalar per vertex is needed in " +
+                                std::string(__func__) + "\n");
+  }
+  int id = add_object(ivertices, ifaces, DEFAULT_COLOR, ObjectType::MESH);
+  update_vertex_scalars(scalars, id);
+  set_colormap(id, colormap, min, max);
+  return id;
+}
+
+void MeshRender::update_vertex_scalars(const std::vector<double> &scalars,
+                                       int id, long int first_vertex) {
+  /* Only the scalars are modified. The packed scalars are quantized in the
+   * range of all the object scalars, so they are all requantized. */
+  Object &obj = live_object(id);
+  auto n_scalars = (long int)scalars.size();
+  if (first_vertex < 0 || first_vertex + n_scalars > obj.n_vertices()) {
+    throw std::invalid_argument("Scalars range out of the object vertices in " +
+                                std::string(__func__) + "\n");
+  }
+
+  long int offset = obj.attr_offset / obj.total_number_attr;
+  redraw = true;
+  if (obj.packed) {
+    std::vector<float> object_scalars;
+    unpack_scalars(obj, object_scalars);
+    std::copy(scalars.begin(), scalars.end(),
+              object_scalars.begin() + first_vertex);
+    pack_scalars(obj, object_scalars.data());
+    packed_vertices_arena.upload(offset, obj.n_vertices());
+    draw_commands_outdated = true; // new decoding range
+    return;
+  }
+  std::copy(scalars.begin(), scalars.end(),
+            scalars_arena.host(offset + first_vertex));
+  scalars_arena.upload(offset + first_vertex, n_scalars);
+}
+
+auto MeshRender::add_mesh(const std::vector<double> &ivertices,
+                          const std::vector<unsigned int> &ifaces,
+                          const std::vector<double> &colors,
+                          const std::vector<double> &normals) -> int {
+  if (normals.size() != ivertices.size()) {
+    throw std::invalid_argument("One normal per vertex is needed in " +
+                                std::string(__func__) + "\n");
+  }
+  int id = add_object(ivertices, ifaces, colors, ObjectType::MESH);
+  update_vertex_normals(normals, id);
+  return id;
+}
+
+void MeshRender::update_vertex_normals(const std::vector<double> &normals,
+                                       int id, long int first_vertex) {
+  /* Only the normals stream is modified, on the given range. The normals
+   * are encoded in parallel. */
+  Object &obj = live_object(id);
+  auto n_normals = (long int)normals.size() / 3;
+  if (obj.object_type != ObjectType::MESH) {
+    throw std::invalid_argument("Only the meshes have normals in " +
+                                std::string(__func__) + "\n");
+  }
+  if (first_vertex < 0 || first_vertex + n_normals > obj.n_vertices()) {
+    throw std::invalid_argument("Normals range out of the object vertices in " +
+                                std::string(__func__) + "\n");
+  }
+
+  long int offset = obj.attr_offset / obj.total_number_attr + first_vertex;
+  redraw = true;
+  if (obj.program_type != ShaderProgramType::SMOOTH_FACES) {
+    obj.program_type = ShaderProgramType::SMOOTH_FACES;
+    get_program(obj.program_type);
+    draw_commands_outdated = true;
+  }
+  if (obj.packed) {
+    int16_t *packed_normals = packed_normals_arena.host(offset);
+    Parallel::for_each(n_normals, [&](long int i) {
+      float oct[2];
+      octahedral(&normals[i * 3], oct);
+      packed_normals[i * 2] = normal_short(oct[0]);
+      packed_normals[i * 2 + 1] = normal_short(oct[1]);
+    });
+    packed_normals_arena.upload(offset, n_normals);
+    return;
+  }
+  float *oct = normals_arena.host(offset);
+  Parallel::for_each(n_normals, [&](long int i) {
+    octahedral(&normals[i * 3], &oct[i * 2]);
+  });
+  normals_arena.upload(offset, n_normals);
+}
+
+auto MeshRender::colormap_layer(const std::vector<double> &colormap) -> int {
+  /* Finds the layer of a colormap, a new colormap is resampled and the
+   * texture is reallocated with all the layers. */
+  auto found = std::find(colormaps.begin(), colormaps.end(), colormap);
+  if (found != colormaps.end()) {
+    return (int)(found - colormaps.begin());
+  }
+  colormaps.push_back(colormap);
+  long int n_colors = (long)colormap.size() / 3;
+  for (int i = 0; i < COLORMAP_SIZE; ++i) {
+    double x = (double)i * (double)(n_colors - 1) / (COLORMAP_SIZE - 1);
+    long int i0 = std::min((long int)x, n_colors - 2);
+    double coef = x - (double)i0;
+    for (int k = 0; k < 3; ++k) {
+      colormaps_texels.push_back((float)(colormap[i0 * 3 + k] * (1 - coef) +
+                                         colormap[(i0 + 1) * 3 + k] * coef));
+    }
+  }
+  glBindTexture(GL_TEXTURE_1D_ARRAY, colormaps_texture);
+  glTexImage2D(GL_TEXTURE_1D_ARRAY, 0, GL_RGB32F, COLORMAP_SIZE,
+               (int)colormaps.size(), 0, GL_RGB, GL_FLOAT,
+               colormaps_texels.data());
+  return (int)colormaps.size() - 1;
+}
+
+void MeshRender::set_colormap(int id, const std::vector<double> &colormap,
+                              double min, double max) {
+  Object &obj = objects.at(id);
+  if (obj.object_type == ObjectType::NONE ||
+      obj.object_type == ObjectType::VECTOR ||
+      obj.object_type == ObjectType::AXIS_CROSS) {
+    throw std::invalid_argument("Only the meshes and curves can use a "
+                                "colormap in " +
+                                std::string(__func__) + "\n");
+  }
+  if (colormap.empty()) {
+    obj.colormap = -1;
+    draw_commands_outdated = true;
+    return;
+  }
+  if (colormap.size() < 6 || colormap.size() % 3 != 0) {
+    throw std::invalid_argument("The colormap should be a list of at least "
+                                "two colors in " +
+                                std::string(__func__) + "\n");
+  }
+  obj.colormap = colormap_layer(colormap);
+  set_colormap_range(id, min, max);
+}
+
+void MeshRender::set_colormap_range(int id, double min, double max) {
+  Object &obj = live_object(id);
+  if (!(max > min)) {
+    throw std::invalid_argument("The colormap range is empty in " +
+                                std::string(__func__) + "\n");
+  }
+  obj.scalar_range[0] = (float)min;
+  obj.scalar_range[1] = (float)max;
+  draw_commands_outdated = true;
+}
+
+void MeshRender::update_bvh(int id) {
+  /* An animated object only moves its vertices, its tree is refitted in
+   * linear time instead of being rebuilt at each pick. */
+  Object &obj = objects.at(id);
+  long int offset = obj.attr_offset / obj.total_number_attr;
+  long int stride = obj.total_number_attr;
+  std::vector<float> decoded;
+  const float *positions = obj.stream.id() != 0
+                               ? (const float *)obj.stream.data()
+                               : vertices_arena.host(offset);
+  if (obj.packed) {
+    const uint16_t *packed = packed_vertices_arena.host(offset);
+    decoded.resize(obj.n_vertices() * 3);
+    for (long int i = 0; i < obj.n_vertices(); ++i) {
+      for (int k = 0; k < 3; ++k) {
+        decoded[i * 3 + k] =
+            obj.position_offset[k] + obj.position_scale[k] *
+                                         (float)packed[i * stride + k] /
+                                         UINT16_MAX;
+      }
+    }
+    positions = decoded.data();
+    stride = 3;
+  }
+  if (!obj.bvh_faces_outdated &&
+      objects_bvh.at(id).refit(positions, stride, obj.n_vertices())) {
+    obj.bvh_outdated = false;
+    return;
+  }
+  const unsigned int *indices = indices_arena.host(obj.faces_indices_offset);
+  std::vector<unsigned int> wide_indices;
+  if (obj.short_indices) {
+    std::vector<uint16_t> short_indices(obj.faces_indices_length);
+    std::memcpy(short_indices.data(), indices,
+                short_indices.size() * sizeof(uint16_t));
+    wide_indices.assign(short_indices.begin(), short_indices.end());
+    indices = wide_indices.data();
+  }
+  objects_bvh.at(id).build(positions, stride, obj.n_vertices(), indices,
+                           obj.faces_indices_length / 3);
+  obj.bvh_outdated = false;
+  obj.bvh_faces_outdated = false;
+}
+
+auto MeshRender::pick(double xpos, double ypos) -> PickResult {
+  /* Inverts the transformation applied in the shaders,
+   *   object       v = scale * w + translation
+   *   rotation     p = q * v * q_inv
+   *   perspective  p.xy *= 2 / (2 - p.z), the eye is at (0, 0, 2)
+   *   zoom and aspect ratio,
+   * then casts a ray from the eye through the cursor.
+   * Only the depth range which is not clipped, p.z in [-1, 1], is
+   * considered. */
+  PickResult result;
+
+  // the view point (x, y, 0) is projected under the cursor
+  double x = (2.0 * xpos / width - 1.0) * width / height / zoom_level;
+  double y = (1.0 - 2.0 * ypos / height) / zoom_level;
+
+  // inverse rotation v = q^-1 * p * q_inv^-1, valid even if the I and O keys
+  // scaled q and q_inv.
+  Quaternion q_left = q.inv();
+  Quaternion q_right = q_inv.inv();
+  Quaternion eye = q_left * Quaternion(0, 0, 0, 2) * q_right;
+  Quaternion ray = q_left * Quaternion(0, x, y, -2) * q_right;
+
+  double origin[] = {eye[1], eye[2], eye[3]};
+  double direction[] = {ray[1], ray[2], ray[3]};
+
+  // p.z = 2 - 2 * t
+  double t_min{0.5};
+  double t_max{1.5};
+
+  objects_bvh.resize(objects.size());
+  RayHit hit;
+  double hit_origin[3];
+  double hit_direction[3];
+  for (int i = 0; i < (int)objects.size(); ++i) {
+    if (objects[i].object_type != ObjectType::MESH) {
+      continue;
+    }
+    if (objects[i].bvh_outdated) {
+      update_bvh(i);
+    }
+    // the ray in the object coordinates, before its transform
+    const float *transform = objects[i].transform;
+    double object_origin[3];
+    double object_direction[3];
+    for (int k = 0; k < 3; ++k) {
+      object_origin[k] = (origin[k] - transform[k]) / transform[3];
+      object_direction[k] = direction[k] / transform[3];
+    }
+    if (objects_bvh[i].intersect(object_origin, object_direction, t_min,
+                                 t_max, hit)) {
+      t_max = hit.t;
+      std::copy(object_origin, object_origin + 3, hit_origin);
+      std::copy(object_direction, object_direction + 3, hit_direction);
+      result.object_id = i;
+      result.face = hit.face;
+      result.barycentric[0] = 1.0 - hit.u - hit.v;
+      result.barycentric[1] = hit.u;
+      result.barycentric[2] = hit.v;
+    }
+  }
+
+  if (result.object_id >= 0) {
+    for (int k = 0; k < 3; ++k) {
+      result.position[k] = hit_origin[k] + t_max * hit_direction[k];
+    }
+  }
+  return result;
+}
+
+void MeshRender::set_pick_callback(
+    void (*pick_function)(const PickResult &pick, void *fargs), void *fargs) {
+  pick_callback = pick_function;
+  pick_callback_args = fargs;
 }
 
 void set_image2D(unsigned int unit, unsigned int *imageID, unsigned int width,
@@ -666,43 +2061,8 @@ void set_image2D(unsigned int unit, unsigned int *imageID, unsigned int width,
 }
 
 auto MeshRender::vertices_stride() -> long int {
-  return std::reduce(VERT_ATTR_LENGTHS.begin(), VERT_ATTR_LENGTHS.end());
-}
-
-auto MeshRender::vertices_attr_offset(VertexAttr attr) -> long int {
-  switch (attr) {
-  case VertexAttr::VERTEX:
-    return 0;
-    break;
-  case VertexAttr::NORMAL:
-    return VERT_ATTR_LENGTHS.at(0);
-    break;
-  case VertexAttr::COLOR:
-    return VERT_ATTR_LENGTHS.at(0); // + VERT_ATTR_LENGTHS.at(1);
-    break;
-  default:
-    return -1;
-  }
-};
-
-auto MeshRender::vertices_attr_size(VertexAttr attr) -> long int {
-  switch (attr) {
-  case VertexAttr::VERTEX:
-    return VERT_ATTR_LENGTHS.at(0);
-    break;
-  case VertexAttr::NORMAL:
-    return VERT_ATTR_LENGTHS.at(1);
-    break;
-  case VertexAttr::COLOR:
-    return VERT_ATTR_LENGTHS.at(1); // + VERT_ATTR_LENGTHS.at(1);
-    break;
-  default:
-    return -1;
-  }
-};
-
-auto MeshRender::n_vertices() -> long int {
-  return (long)vertices_attr.size() / vertices_stride();
+  // number of elements per vertex in the positions stream
+  return VERT_ATTR_LENGTHS.at(0);
 }
 
 void cursor_callback(GLFWwindow *window, double xpos, double ypos) {
@@ -723,16 +2083,37 @@ void cursor_callback(GLFWwindow *window, double xpos, double ypos) {
 
     render->q = q_new * render->q;
     render->q_inv = render->q_inv * q_new.inv();
+    render->redraw = true;
+  } else {
+    auto *render = (MeshRender *)glfwGetWindowUserPointer(window);
+    if (render->picking_mode && render->pick_callback != nullptr) {
+      render->pick_callback(render->pick(xpos, ypos),
+                            render->pick_callback_args);
+    }
   }
 
   x_old = xpos;
   y_old = ypos;
 }
 
+void mouse_button_callback(GLFWwindow *window, int button, int action,
+                           __attribute__((unused)) int mods) {
+  auto *render = (MeshRender *)glfwGetWindowUserPointer(window);
+  if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS &&
+      render->pick_callback != nullptr) {
+    double xpos{0};
+    double ypos{0};
+    glfwGetCursorPos(window, &xpos, &ypos);
+    render->pick_callback(render->pick(xpos, ypos),
+                          render->pick_callback_args);
+  }
+}
+
 void scroll_callback(GLFWwindow *window, __attribute__((unused)) double xoffset,
                      double yoffset) {
   auto *rdr = (MeshRender *)glfwGetWindowUserPointer(window);
   rdr->zoom_level *= 1.0 + yoffset * SCROLL_SENSITIVITY;
+  rdr->redraw = true;
 }
 
 void keyboard_callback(__attribute__((unused)) GLFWwindow *window, int key,
@@ -745,10 +2126,18 @@ void keyboard_callback(__attribute__((unused)) GLFWwindow *window, int key,
     case GLFW_KEY_I:
       rdr->q *= 1.1;
       rdr->q_inv *= 1.1;
+      rdr->redraw = true;
       break;
     case GLFW_KEY_O:
       rdr->q *= 0.9;
       rdr->q_inv *= 0.9;
+      rdr->redraw = true;
+      break;
+    case GLFW_KEY_P:
+      rdr->picking_mode = !rdr->picking_mode;
+      break;
+    case GLFW_KEY_T:
+      rdr->set_stats_overlay(!rdr->stats_overlay);
       break;
     case GLFW_KEY_ESCAPE:
       glfwSetWindowShouldClose(window, 1);
@@ -1,20 +1,32 @@
 #ifndef TRIMESH_RENDER_H_
 #define TRIMESH_RENDER_H_
 
+#include "buffer_arena.hpp"
+#include "bvh.hpp"
 #include "compile_shader.hpp"
+#include "frame_capture.hpp"
+#include "frame_timer.hpp"
 #include "glad/include/glad/glad.h" // glad should be included before glfw3
 #include "quatern_transform.hpp"
+#include "stream_buffer.hpp"
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <string>
 #include <vector>
 
 enum class CurveType : int {
   QUAD_CURVE,
   TUBE_CURVE,
   SMOOTH_TUBE_CURVE,
+  EXTRUDED_TUBE, // smooth tube extruded once on the CPU, drawn as a mesh
 };
 
+// vertices per ring of the extruded tubes
+constexpr int TUBE_SIDES{8};
+
 enum class ObjectType : int {
   NONE,
   MESH,
@@ -25,6 +37,44 @@ enum class ObjectType : int {
   AXIS_CROSS,
 };
 
+enum class RenderMode : int {
+  WINDOW,   // glfw window
+  HEADLESS, // offscreen EGL context, no display needed
+};
+
+struct PickResult {
+  /* Object under the cursor, object_id is -1 if nothing was hit. */
+  int object_id{-1};
+  long int face{-1}; // face index in the object faces
+  // barycentric coordinates of the object face vertices 0, 1, 2
+  double barycentric[3]{0, 0, 0};
+  double position[3]{0, 0, 0}; // intersection point, object coordinates
+};
+
+struct CullingStats {
+  // Objects of the last frame, the axis cross is not counted.
+  int n_objects{0};
+  int n_culled{0}; // outside the view volume, not drawn
+};
+
+struct FrameObject {
+  /* New data of one object, the empty vectors leave the object unchanged.
+   * If faces is given, the number of vertices can change. */
+  int id{-1};
+  std::vector<double> vertices;
+  std::vector<double> colors;
+  std::vector<unsigned int> faces;
+};
+
+struct SimulationFrame {
+  // Objects updated by one simulation step.
+  std::vector<FrameObject> objects;
+
+  // Adds the updates of an older frame which are not replaced by this
+  // frame, so that no update is lost when the older frame is not drawn.
+  void merge(const SimulationFrame &older);
+};
+
 class MeshRender {
 public:
   auto add_mesh(const std::vector<double> &ivertices,
@@ -34,9 +84,50 @@ public:
                 const std::vector<unsigned int> &ifaces,
                 const std::vector<double> &colors) -> int;
 
+  // Smooth shaded mesh, with one normal per vertex (e.g.
+  // Mesh::vertex_normals).
+  auto add_mesh(const std::vector<double> &ivertices,
+                const std::vector<unsigned int> &ifaces,
+                const std::vector<double> &colors,
+                const std::vector<double> &normals) -> int;
+
+  // Updates the normals of the vertices first_vertex to
+  // first_vertex + normals.size() / 3, only this range is uploaded. A flat
+  // shaded mesh becomes smooth shaded.
+  void update_vertex_normals(const std::vector<double> &normals, int id,
+                             long int first_vertex = 0);
+
   void update_vertex_colors(std::vector<double> &colors,
                             unsigned int object_idx);
 
+  // Updates the colors of the vertices first_vertex to
+  // first_vertex + colors.size() / 3 of an object, only this range is
+  // uploaded.
+  void update_vertex_colors(const std::vector<double> &colors,
+                            unsigned int object_idx, long int first_vertex);
+
+  // Colors the mesh with a colormap (r, g, b list, e.g. Colormap::VIRIDIS)
+  // applied on the GPU to one scalar per vertex, between min and max.
+  auto add_mesh(const std::vector<double> &ivertices,
+                const std::vector<unsigned int> &ifaces,
+                const std::vector<double> &scalars,
+                const std::vector<double> &colormap, double min,
+                double max) -> int;
+
+  // Updates the scalars of the vertices first_vertex to
+  // first_vertex + scalars.size(), only this range is uploaded. A curve has
+  // a ghost vertex before its first point and after its last point.
+  void update_vertex_scalars(const std::vector<double> &scalars, int id,
+                             long int first_vertex = 0);
+
+  // The colors of a mesh or a curve are looked up in the colormap texture
+  // from its vertex scalars, the colormaps are uploaded once. An empty
+  // colormap restores the vertex colors.
+  void set_colormap(int id, const std::vector<double> &colormap, double min,
+                    double max);
+  // Only changes the objects data, nothing is recomputed or uploaded.
+  void set_colormap_range(int id, double min, double max);
+
   void update_object(const std::vector<double> &ivertices, int id);
 
   void update_object(const std::vector<double> &ivertices,
@@ -46,6 +137,60 @@ public:
                      const std::vector<unsigned int> &ifaces,
                      const std::vector<double> &icolors, int id);
 
+  // Frees the object storage, the ids of the other objects are unchanged.
+  // The updates of a removed object throw std::invalid_argument.
+  void remove_object(int id);
+
+  // Translation and uniform scale applied to a mesh or a curve before the
+  // rotation.
+  void set_object_transform(int id, const std::vector<double> &translation,
+                            double scale);
+
+  // Multiplies the colors of a mesh or a curve by tint (r, g, b).
+  void set_object_tint(int id, const std::vector<double> &tint);
+
+  // Skips the objects outside the view volume, enabled by default.
+  void set_culling(bool enabled) { culling = enabled; }
+  [[nodiscard]] auto get_culling_stats() const -> CullingStats {
+    return culling_stats;
+  }
+
+  // Measures the CPU and GPU durations of the phases of each frame, with
+  // per_object the GPU draw time of each object too, in which case the
+  // objects are drawn one by one. The statistics are rolling, over the last
+  // FrameTimer::WINDOW frames.
+  void set_timing(bool enabled, bool per_object = false);
+  [[nodiscard]] auto get_phase_timings(FramePhase phase) const
+      -> PhaseTimings {
+    return timer.phase_timings(phase);
+  }
+  // GPU draw time of an object, with per object timing.
+  [[nodiscard]] auto get_object_timings(int id) const -> TimingStats {
+    return timer.object_timings(id);
+  }
+  // Shows the timings and the culling statistics over the objects, toggled
+  // by the T key. Enables the timing.
+  void set_stats_overlay(bool enabled);
+
+  // Stores the vertices of a mesh or a curve in the packed format: the
+  // positions are quantized on 16 bits in the object bounding box and
+  // decoded in the vertex shader, the colors are 8 bits. The vertices use
+  // half the memory and upload bandwidth, the precision is the size of the
+  // box divided by 65535. A packed object can't be streamed.
+  // The vectors positions and directions become half floats and their
+  // colors bytes, 20 bytes per vector instead of 36.
+  void set_packed(int id);
+
+  // Streams the positions of an animated object through a persistently
+  // mapped, triple buffered region: update_object(vertices, id) then writes
+  // directly in GPU visible memory, without waiting for the GPU.
+  // Does nothing if openGL 4.4 is not available.
+  void set_streaming(int id);
+
+  // Positions (x, y, z as floats) of a streamed object for the next frame,
+  // to be fully written before the next draw.
+  auto map_vertices(int id) -> float *;
+
   // Draws a set of vector or a single vectors
   auto add_vectors(const std::vector<double> &coords,
                    const std::vector<double> &directions) -> int;
@@ -54,6 +199,14 @@ public:
                    const std::vector<double> &directions,
                    const std::vector<double> &colors) -> int;
 
+  // Replaces the vectors of a vector object, their number can change.
+  // The vectors are written in a persistently mapped, triple buffered
+  // region which is only reallocated when it grows, so that a field can be
+  // animated without waiting for the GPU.
+  void update_vectors(int id, const std::vector<double> &coords,
+                      const std::vector<double> &directions,
+                      const std::vector<double> &colors);
+
   auto add_curve(const std::vector<double> &coords,
                  const std::vector<double> &colors, CurveType type,
                  double width) -> int;
@@ -63,20 +216,90 @@ public:
                   const std::vector<unsigned int> &curves_indices,
                   CurveType type, double width) -> int;
 
+  // Adds many polylines as one object, the curve c has the points
+  // curves_offsets[c] to curves_offsets[c + 1] (excluded), the last offset
+  // is the number of points. colors has one color per point or a single
+  // color. The gost points and the lines adjacency indices are generated
+  // in one parallel pass. Each curve has a gost vertex before its first
+  // point and after its last point.
+  auto add_curves(const std::vector<double> &coords,
+                  const std::vector<double> &colors,
+                  const std::vector<long int> &curves_offsets, CurveType type,
+                  double width) -> int;
+
+  // Extrudes tubes of radius width around the curves on the CPU, with
+  // parallel transport frames, and adds them as one smooth shaded mesh, so
+  // that static curves are drawn without geometry shader. The curve c has
+  // the points curves_offsets[c] to curves_offsets[c + 1] (excluded), the
+  // last offset is the number of points. colors has one color per point or
+  // a single color. The vertices of the object are those of the tubes.
+  auto add_tubes(const std::vector<double> &coords,
+                 const std::vector<double> &colors,
+                 const std::vector<long int> &curves_offsets, double width,
+                 int n_sides = TUBE_SIDES) -> int;
+
   void set_axis_cross();
 
-  MeshRender(int w_width, int w_height) : width(w_width), height(w_height) {
-    init_window();
+  // Casts a ray from the cursor position (in screen coordinates) through the
+  // mesh objects, inverting the transformation applied in the shaders.
+  auto pick(double xpos, double ypos) -> PickResult;
+
+  // The callback is called on right click, and on cursor motion when the
+  // picking mode is toggled with the P key.
+  void set_pick_callback(void (*pick_function)(const PickResult &pick,
+                                               void *fargs),
+                         void *fargs);
+
+  MeshRender(int w_width, int w_height,
+             RenderMode mode = RenderMode::WINDOW)
+      : width(w_width), height(w_height),
+        headless(mode == RenderMode::HEADLESS) {
+    if (headless) {
+      init_headless();
+    } else {
+      init_window();
+    }
     init_storage();
-    vertices_attr.resize(0);
-    faces.resize(0);
     objects.resize(0);
   }
 
+  // Draws the objects and writes the image as a .png or .ppm file, in
+  // headless mode the frame is rendered in a framebuffer object.
+  void render_to_file(const std::string &fname);
+
+  // Writes each frame drawn by the render loops or draw_frame to
+  // fname_pattern, a printf format taking the frame number as an int
+  // (e.g. "frames/%05d.png"), other patterns throw std::invalid_argument.
+  // The frames are read back asynchronously and written by a worker
+  // thread.
+  void start_capture(const std::string &fname_pattern);
+  // Writes the remaining frames.
+  void stop_capture();
+
   auto render_finalize() -> int;
+  // With on demand rendering, a frame is drawn only when the view or the
+  // objects changed: without data_update_function, the loop sleeps until
+  // the next event, otherwise data_update_function is called at most every
+  // IDLE_PERIOD seconds while nothing changes.
   auto render_loop(int (*data_update_function)(void *fargs),
                    void *fargs) -> int;
 
+  // Runs simulation_function on its own thread until it returns 0 or the
+  // window is closed. Each call fills a frame which is handed to the render
+  // thread without locks, the latest complete frame is drawn and the
+  // rotation and zoom stay smooth whatever the simulation rate.
+  // The frame passed to the simulation holds the data of an older step.
+  // A frame which is replaced before being drawn is merged in the next
+  // one, the partial updates of a FrameObject are never lost.
+  auto render_loop_async(int (*simulation_function)(SimulationFrame &frame,
+                                                    void *fargs),
+                         void *fargs) -> int;
+
+  // Enabled by default, otherwise the render loops draw continuously.
+  void set_on_demand(bool enabled) { on_demand = enabled; }
+  // Marks the frame to be redrawn, the update methods call it.
+  void request_redraw() { redraw = true; }
+
   void init_frame() const;
   void draw_frame();
   // void add_vertex_normals(std::vector<double> &normals);
@@ -84,8 +307,6 @@ public:
 private:
   class Object {
     // Represent a mesh to be rendered and its positions in the openGL buffers.
-    void set_shader_program();
-
   public:
     ObjectType object_type{ObjectType::NONE};
 
@@ -94,7 +315,7 @@ private:
     // number of elements in the Vertex Buffer Object
     long int attr_length{-1};
 
-    // total number of attributes per vertex (vvvnnnccc) -> 9
+    // number of elements per vertex in the positions stream (vvv) -> 3
     long int total_number_attr{-1};
 
     auto n_vertices() const -> long int {
@@ -111,13 +332,56 @@ private:
       return faces_indices_length / vertices_per_primitive;
     }
 
-    // each object has its own shader program for flexibility
-    int shader_program{0};
-    // Transformation quaternions uniforms
-    int q_loc{0}, q_inv_loc{0};
-    int zoom_loc{0};          // zoom uniform
-    int viewport_size_loc{0}; // uniform to keep the aspect ratio
+    // Objects with less than 65536 vertices have 16 bits indices, stored
+    // two per element of the indices arena.
+    bool short_indices{false};
+    auto indices_units() const -> long int {
+      return short_indices ? (faces_indices_length + 1) / 2
+                           : faces_indices_length;
+    }
+    auto index_type() const -> unsigned int {
+      return short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    // the shader program is shared by all the objects of a same type
+    ShaderProgramType program_type{ShaderProgramType::FLAT_FACES};
+    // per object data of the meshes and curves, read from the objects SSBO
+    float transform[4]{0, 0, 0, 1}; // translation x, y, z and scale
+    float tint[3]{1, 1, 1};         // multiplies the vertex colors
+    float width{0};                 // curves width
+    // colormap texture layer, -1 for the vertex colors, and scalars range
+    int colormap{-1};
+    float scalar_range[2]{0, 1};
+
+    // in the packed format, the positions are
+    // position_offset + position_scale * unorm16
+    bool packed{false};
+    float position_offset[3]{0, 0, 0};
+    float position_scale[3]{1, 1, 1};
+    // the scalars are quantized in the 4th component of the positions,
+    // scalar_offset + scalar_scale * unorm16
+    float scalar_offset{0};
+    float scalar_scale{1};
+
+    // bounding sphere center and radius, object coordinates, computed when
+    // the vertices are set; the radius is negative if unknown (never culled)
+    float bounds[4]{0, 0, 0, -1};
+    // per instance attributes of the vectors, streamed, or in
+    // instances_VBO without openGL 4.4
     int n_instances{0};
+    bool half_instances{false};
+    StreamBuffer instances;
+    unsigned int instances_VBO{0};
+    unsigned int instances_VAO{0};
+
+    // positions of a streamed object, read with its own VAO
+    StreamBuffer stream;
+    unsigned int stream_VAO{0};
+
+    // the picking structure needs to be updated, it is rebuilt if the faces
+    // changed, otherwise refitted to the new positions
+    bool bvh_outdated{true};
+    bool bvh_faces_outdated{true};
 
     Object() = default;
 
@@ -126,24 +390,42 @@ private:
            long int indices_length, long int vertices_per_primitive);
   };
 
-  enum class VertexAttr : int {
-    VERTEX,
-    NORMAL,
-    COLOR,
-  };
-
   // viewport size
   int width{0}, height{0};
 
-  // contains vertices coordinates , colors, normals... for all meshes
-  std::vector<float> vertices_attr;
-  // list of vertices for each triangular face for all meshes
-  std::vector<unsigned int> faces;
+  // Vertices coordinates and colors for all meshes, in separate streams
+  // allocated by vertex, and the list of vertices of each face for all
+  // meshes. The two vertex streams receive the same allocations so that an
+  // object has the same base vertex in both.
+  BufferArena<float> vertices_arena;
+  BufferArena<float> colors_arena;
+  BufferArena<float> scalars_arena; // colormapped values
+  BufferArena<float> normals_arena; // octahedral normals, smooth shading
+  BufferArena<unsigned int> indices_arena;
+  // the packed objects streams, read with the packed VAO
+  BufferArena<uint16_t> packed_vertices_arena;
+  BufferArena<uint8_t> packed_colors_arena;
+  BufferArena<int16_t> packed_normals_arena;
+  auto allocate_vertices(long int n, bool packed) -> long int;
+  auto resize_vertices(long int offset, long int n, long int new_n,
+                       bool packed) -> long int;
+  void release_vertices(long int offset, long int n, bool packed);
+  void compact_storage();
+  void init_stream(Object &obj);
+  void stream_positions(Object &obj);
 
   static auto vertices_stride() -> long int;
-  static auto vertices_attr_offset(VertexAttr attr) -> long int;
-  auto vertices_attr_size(VertexAttr attr) -> long int;
-  auto n_vertices() -> long int;
+  template <class T>
+  void pack_positions(Object &obj, const T *positions, long int n_vertices);
+  void pack_scalars(Object &obj, const float *scalars);
+  void unpack_scalars(const Object &obj, std::vector<float> &scalars);
+
+  // Colormaps resampled to COLORMAP_SIZE colors, one layer of the 1D array
+  // texture each.
+  unsigned int colormaps_texture{0};
+  std::vector<std::vector<double>> colormaps;
+  std::vector<float> colormaps_texels; // rgb
+  auto colormap_layer(const std::vector<double> &colormap) -> int;
 
   // defining the rotation transformation of the current view.
   Quaternion q{1, 0, 0, 0}, q_inv{1, 0, 0, 0};
@@ -152,38 +434,152 @@ private:
                         // want to break through the object.
 
   void *userpointer{this}; // for use in glfw callback
+
+  bool on_demand{true};
+  bool redraw{true}; // dirty flag of on demand rendering
+  // the objects changes which rebuild the draw commands also need a redraw
+  [[nodiscard]] auto needs_redraw() const -> bool {
+    return redraw || draw_commands_outdated;
+  }
   GLFWwindow *window{};
 
+  // headless rendering, multisampled framebuffer resolved before reading
+  bool headless{false};
+  void *egl_display{nullptr};
+  void *egl_context{nullptr};
+  unsigned int offscreen_FBO{0}, resolve_FBO{0};
+  unsigned int offscreen_RBOs[3]{0, 0, 0}; // color, depth, resolved color
+  void init_headless();
+  void finalize_headless();
+  // the size of the window framebuffer can differ from the window size
+  void read_pixels(std::vector<unsigned char> &rgb, int image_width,
+                   int image_height);
+  void bind_read_framebuffer();
+
+  FrameCapture capture;
+  void capture_frame();
+
+  FrameTimer timer;
+  // text of the overlay, column, row and glyph of each character
+  bool stats_overlay{false};
+  unsigned int overlay_VAO{0}, overlay_VBO{0};
+  std::vector<int> overlay_chars;
+  std::chrono::steady_clock::time_point overlay_time;
+  void init_overlay();
+  void write_overlay_text();
+  void draw_overlay();
+
+  // picking structures for each object, built at the first pick
+  std::vector<Bvh> objects_bvh;
+  bool picking_mode{false};
+  void (*pick_callback)(const PickResult &pick, void *fargs){nullptr};
+  void *pick_callback_args{nullptr};
+  void update_bvh(int id);
+
+  struct ShaderProgram {
+    // Compiled program and its uniforms locations.
+    int id{0};
+    int first_object_loc{-1}; // objects SSBO index of gl_DrawID 0
+  };
+
+  struct CameraBlock {
+    // std140 layout of the Camera uniform block shared by the shaders.
+    float q[4];
+    float q_inv[4];
+    float viewport_size[2]; // to keep the aspect ratio
+    float zoom_level;
+    float padding;
+  };
+  unsigned int camera_UBO{0};
+  void update_camera();
+
+  struct DrawCommand {
+    // Layout of glMultiDrawElementsIndirect commands.
+    unsigned int count{0};
+    unsigned int instance_count{1};
+    unsigned int first_index{0};
+    int base_vertex{0};
+    unsigned int base_instance{0};
+  };
+
+  struct DrawItem {
+    /* A range of indirect commands drawn by one call, or, if n_commands is
+     * 0, the object id drawn by draw(). A streamed object has its own range
+     * and its id. */
+    ShaderProgramType program_type{ShaderProgramType::FLAT_FACES};
+    unsigned int mode{GL_TRIANGLES};
+    unsigned int vertex_array{0};
+    unsigned int index_type{GL_UNSIGNED_INT};
+    int id{-1};
+    long int first_command{0};
+    long int n_commands{0};
+  };
+
+  // one program per type, compiled at its first use
+  std::map<ShaderProgramType, ShaderProgram> programs;
+  auto get_program(ShaderProgramType type) -> ShaderProgram &;
+
+  // Draw calls sorted by shader program. The meshes and curves are batched
+  // in indirect commands, their data is in the SSBO at the command index.
+  std::vector<DrawItem> draw_items;
+  std::vector<DrawCommand> draw_commands;
+  // scale, width, translation, tint, colormap
+  std::vector<float> objects_data;
+  unsigned int indirect_buffer{0}, objects_SSBO{0};
+  // set when objects are added, moved in the buffers or modified
+  bool draw_commands_outdated{true};
+  std::vector<int> command_objects; // object id of each command
+  void build_draw_commands();
+
+  bool culling{true};
+  CullingStats culling_stats;
+  void cull_objects();
+  auto is_visible(const Object &obj) -> bool;
+  template <class T>
+  void set_bounds(Object &obj, const T *positions, long int n_vertices);
+  void bind_stream(Object &obj);
+  void draw_each_command(const DrawItem &item, const ShaderProgram &program);
+  void write_instances(Object &obj, const std::vector<double> &coords,
+                       const std::vector<double> &directions,
+                       const std::vector<double> &colors);
+  void bind_instances(Object &obj);
+  void pack_instances(Object &obj);
+
   // ID of the global mesh storage
-  unsigned int VAO{0}, VBO{0}, EBO{0};
+  unsigned int VAO{0}, VBO{0}, color_VBO{0}, scalar_VBO{0}, normal_VBO{0},
+      EBO{0};
+  unsigned int packed_VAO{0}, packed_VBO{0}, packed_color_VBO{0},
+      packed_normal_VBO{0};
 
   // list of object to be rendered
   std::vector<Object> objects;
 
   void init_window();
   void init_storage();
-  void resize_VBO();
-  void resize_EBO();
+  void draw_objects();
+  void apply_frame(const SimulationFrame &frame);
   void draw(Object &obj);
 
   friend void cursor_callback(GLFWwindow *window, double xpos, double ypos);
   friend void scroll_callback(GLFWwindow *window,
                               __attribute__((unused)) double xoffset,
                               double yoffset);
+  friend void mouse_button_callback(GLFWwindow *window, int button,
+                                    int action,
+                                    __attribute__((unused)) int mods);
   friend void keyboard_callback(__attribute__((unused)) GLFWwindow *window,
                                 int key, __attribute__((unused)) int scancode,
                                 int action, __attribute__((unused)) int mods);
 
-  void add_indices(const std::vector<unsigned int> &new_indices);
+  // the object to update, throws if it has been removed
+  auto live_object(int id) -> Object &;
   void update_indices(const std::vector<unsigned int> &new_indices,
                       Object &obj);
+  void write_indices(const std::vector<unsigned int> &indices,
+                     const Object &obj);
 
   void fill_vertice_attr(const std::vector<double> &new_vertices,
-                         const std::vector<double> &new_colors,
-                         long int vertices_offset);
-
-  void add_vertices(const std::vector<double> &new_vertices,
-                    const std::vector<double> &colors);
+                         const std::vector<double> &new_colors, Object &obj);
 
   void update_vertices(const std::vector<double> &new_vertices,
                        const std::vector<double> &colors, Object &obj);
@@ -197,10 +593,14 @@ private:
                   const std::vector<double> &colors,
                   ObjectType object_type) -> int;
 
-  void fill_vectors_instance_attr(const std::vector<double> &coords,
-                                  const std::vector<double> &directions,
-                                  const std::vector<double> &colors,
-                                  std::vector<float> &instances_attr);
+  static void check_curves(const std::vector<double> &coords,
+                           const std::vector<double> &colors,
+                           const std::vector<long int> &curves_offsets);
+  // extruded tubes of the curves given by lines adjacency indices
+  auto add_adjacency_tubes(const std::vector<double> &coords,
+                           const std::vector<double> &colors,
+                           const std::vector<unsigned int> &indices,
+                           double width) -> int;
 };
 
 // convert between different types
@@ -218,14 +618,33 @@ const std::map<ObjectType, int> OBJECT_VERTICES_PER_PRIMITIVE_MAP{
     {ObjectType::TUBE_CURVE, 4}, {ObjectType::SMOOTH_TUBE_CURVE, 4},
     {ObjectType::AXIS_CROSS, 3}};
 
-// Number of elements per vertices attrib group (position, normal, color)
-// if modifying, change vertices_attr_offset() and vertices_attr_size();
-const std::vector<long int> VERT_ATTR_LENGTHS{3, 3};
+// Number of elements per vertex of each attribute stream (position, color,
+// scalar, normal), the attribute i is read from the stream i. The normals
+// are stored by their octahedral projection on the square [-1, 1]^2.
+const std::vector<long int> VERT_ATTR_LENGTHS{3, 3, 1, 2};
+// In the packed format, x, y, z and scalar as normalized 16 bits integers,
+// r, g, b, a as normalized bytes and the octahedral normals as normalized
+// signed 16 bits integers.
+const std::vector<long int> PACKED_ATTR_LENGTHS{4, 4, 2};
+// Bytes per vector: position, direction and color as floats, or in the
+// packed format, position and direction as half floats (x, y, z, padding)
+// and r, g, b, a as normalized bytes.
+constexpr long int INSTANCE_SIZE{9 * sizeof(float)};
+constexpr long int PACKED_INSTANCE_SIZE{8 * sizeof(uint16_t) + 4};
 
 const std::vector<double> DEFAULT_COLOR{0.0, 0.7, 0.8};
 
+// colors per layer of the colormaps texture
+constexpr int COLORMAP_SIZE{256};
+
+// seconds between the data_update_function calls of an idle render loop
+constexpr double IDLE_PERIOD{1.0 / 60.0};
+
 void keyboard_callback(GLFWwindow *window, int key, int scancode, int action,
                        int mods);
 void cursor_callback(GLFWwindow *window, double xpos, double ypos);
+void mouse_button_callback(GLFWwindow *window, int button, int action,
+                           int mods);
 void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+void window_refresh_callback(GLFWwindow *window);
 #endif // TRIMESH_RENDER_H_
@@ -0,0 +1,52 @@
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+#include <atomic>
+
+template <class T> class TripleBuffer {
+  /* Lock-free handoff between one producer thread and one consumer thread.
+   * The producer writes its back slot and publishes it by swapping it with
+   * the middle slot, the consumer takes the middle slot when it is fresh.
+   * Neither side ever waits, the consumer always gets the latest complete
+   * slot and the intermediate ones are dropped, unless the producer merges
+   * the unread slot in the slot it publishes.
+   * The slots are reused, a slot given to the producer holds old data. */
+
+  static constexpr int INDEX_MASK{3};
+  static constexpr int FRESH{4}; // the middle slot has not been read yet
+
+  T slots[3];
+  std::atomic<int> middle{1};
+  int back{0};  // owned by the producer
+  int front{2}; // owned by the consumer
+
+public:
+  // producer side
+  auto write_slot() -> T & { return slots[back]; }
+
+  void publish() {
+    back = middle.exchange(back | FRESH, std::memory_order_acq_rel) &
+           INDEX_MASK;
+  }
+
+  // producer side, the published slot which has not been read yet, if any.
+  // The consumer can take it at any time, so it is only read, and its data
+  // can then be applied twice.
+  auto unread_slot() const -> const T * {
+    int state = middle.load(std::memory_order_acquire);
+    return (state & FRESH) != 0 ? &slots[state & INDEX_MASK] : nullptr;
+  }
+
+  // consumer side, returns true if a new slot was published since the last
+  // call
+  auto update() -> bool {
+    if ((middle.load(std::memory_order_acquire) & FRESH) == 0) {
+      return false;
+    }
+    front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+    return true;
+  }
+
+  auto read_slot() -> T & { return slots[front]; }
+};
+
+#endif // TRIPLE_BUFFER_H_
@@ -0,0 +1,195 @@
+/* These methods extrude the tubes of the curves on the CPU, as meshes. */
+#include "../mesh/parallel.hpp"
+#include "trimesh_render.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+constexpr double TAU{6.283185307179586};
+
+static auto dot(const double *u, const double *v) -> double {
+  return u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+}
+
+static void normalize(double *u) {
+  double norm = std::sqrt(dot(u, u));
+  if (norm > 0) {
+    for (int k = 0; k < 3; ++k) {
+      u[k] /= norm;
+    }
+  }
+}
+
+static void reflect(double *u, const double *v, double v2) {
+  // reflection of u by the plane normal to v, v2 = |v|^2
+  double alpha = 2 * dot(v, u) / v2;
+  for (int k = 0; k < 3; ++k) {
+    u[k] -= alpha * v[k];
+  }
+}
+
+static void project(double *u, const double *t) {
+  // projection of u on the plane normal to the unit vector t
+  double alpha = dot(u, t);
+  for (int k = 0; k < 3; ++k) {
+    u[k] -= alpha * t[k];
+  }
+}
+
+static void tangent(const double *points, long int n, long int i,
+                    double *t) {
+  // central difference, one sided at the ends
+  long int a = i > 0 ? i - 1 : 0;
+  long int b = i < n - 1 ? i + 1 : n - 1;
+  for (int k = 0; k < 3; ++k) {
+    t[k] = points[b * 3 + k] - points[a * 3 + k];
+  }
+  normalize(t);
+}
+
+static void extrude_tube(const double *points, long int n, double radius,
+                         const std::vector<double> &ring, double *vertices,
+                         double *normals) {
+  /* Writes a ring of vertices around each point, in the plane normal to the
+   * tangent, ring holds the cosine and sine of each side. The frames are
+   * propagated along the curve by parallel transport, computed by double
+   * reflection (Wang et al. 2008), so that the tube does not twist. */
+  auto n_sides = (long int)ring.size() / 2;
+  double t[3];
+  tangent(points, n, 0, t);
+  // first normal, any vector orthogonal to the tangent
+  double r[3]{0, 0, 0};
+  r[std::abs(t[0]) < 0.9 ? 0 : 1] = 1;
+  project(r, t);
+  normalize(r);
+
+  for (long int i = 0; i < n; ++i) {
+    if (i > 0) {
+      double v1[3];
+      for (int k = 0; k < 3; ++k) {
+        v1[k] = points[i * 3 + k] - points[(i - 1) * 3 + k];
+      }
+      double c1 = dot(v1, v1);
+      double t_left[3]{t[0], t[1], t[2]};
+      if (c1 > 0) {
+        reflect(r, v1, c1);
+        reflect(t_left, v1, c1);
+      }
+      tangent(points, n, i, t);
+      double v2[3];
+      for (int k = 0; k < 3; ++k) {
+        v2[k] = t[k] - t_left[k];
+      }
+      double c2 = dot(v2, v2);
+      if (c2 > 1e-24) {
+        reflect(r, v2, c2);
+      }
+      // removes the rounding errors
+      project(r, t);
+      normalize(r);
+    }
+    double b[3]{t[1] * r[2] - t[2] * r[1], t[2] * r[0] - t[0] * r[2],
+                t[0] * r[1] - t[1] * r[0]};
+    for (long int j = 0; j < n_sides; ++j) {
+      long int v = (i * n_sides + j) * 3;
+      for (int k = 0; k < 3; ++k) {
+        normals[v + k] = ring[j * 2] * r[k] + ring[j * 2 + 1] * b[k];
+        vertices[v + k] = points[i * 3 + k] + radius * normals[v + k];
+      }
+    }
+  }
+}
+
+auto MeshRender::add_tubes(const std::vector<double> &coords,
+                           const std::vector<double> &colors,
+                           const std::vector<long int> &curves_offsets,
+                           double width, int n_sides) -> int {
+  /* The curve c has the points curves_offsets[c] to
+   * curves_offsets[c + 1], its rings of vertices start at the vertex
+   * curves_offsets[c] * n_sides and its faces at the face
+   * (curves_offsets[c] - c) * 2 * n_sides. The curves are extruded in
+   * parallel. */
+  check_curves(coords, colors, curves_offsets);
+  if (n_sides < 3) {
+    throw std::invalid_argument("A tube needs at least 3 sides in " +
+                                std::string(__func__) + "\n");
+  }
+  auto n_points = (long int)coords.size() / 3;
+  auto n_curves = (long int)curves_offsets.size() - 1;
+
+  std::vector<double> ring(n_sides * 2);
+  for (int j = 0; j < n_sides; ++j) {
+    ring[j * 2] = std::cos(TAU * j / n_sides);
+    ring[j * 2 + 1] = std::sin(TAU * j / n_sides);
+  }
+
+  std::vector<double> vertices(n_points * n_sides * 3);
+  std::vector<double> normals(vertices.size());
+  std::vector<double> vertex_colors(vertices.size());
+  std::vector<unsigned int> faces((n_points - n_curves) * n_sides * 6);
+
+  Parallel::for_each_range(curves_offsets, [&](long int c) {
+    long int first = curves_offsets[c];
+    long int n = curves_offsets[c + 1] - first;
+    long int first_vertex = first * n_sides;
+    extrude_tube(&coords[first * 3], n, width, ring,
+                 &vertices[first_vertex * 3], &normals[first_vertex * 3]);
+
+    for (long int i = 0; i < n * n_sides; ++i) {
+      long int point = colors.size() == 3 ? 0 : first + i / n_sides;
+      for (int k = 0; k < 3; ++k) {
+        vertex_colors[(first_vertex + i) * 3 + k] = colors[point * 3 + k];
+      }
+    }
+
+    // two triangles between each side of consecutive rings
+    unsigned int *face = &faces[(first - c) * n_sides * 6];
+    for (long int i = 0; i < n - 1; ++i) {
+      for (int j = 0; j < n_sides; ++j) {
+        auto v0 = (unsigned int)(first_vertex + i * n_sides + j);
+        auto v1 =
+            (unsigned int)(first_vertex + i * n_sides + (j + 1) % n_sides);
+        unsigned int quad[6]{v0, v1, v0 + n_sides,
+                             v1, v1 + n_sides, v0 + n_sides};
+        std::copy(quad, quad + 6, face);
+        face += 6;
+      }
+    }
+  });
+
+  return add_mesh(vertices, faces, vertex_colors, normals);
+}
+
+auto MeshRender::add_adjacency_tubes(const std::vector<double> &coords,
+                                     const std::vector<double> &colors,
+                                     const std::vector<unsigned int> &indices,
+                                     double width) -> int {
+  /* The segment drawn by each group of 4 indices is the middle one, the
+   * curves are the chains of consecutive segments. */
+  if (colors.size() != coords.size() && colors.size() != 3) {
+    throw std::invalid_argument("Coords size and colors size don't match in " +
+                                std::string(__func__) + "\n");
+  }
+  std::vector<double> points;
+  std::vector<double> points_colors;
+  std::vector<long int> offsets;
+  auto add_point = [&](unsigned int point) {
+    points.insert(points.end(), &coords.at(point * 3), &coords[point * 3] + 3);
+    if (colors.size() != 3) {
+      points_colors.insert(points_colors.end(), &colors[point * 3],
+                           &colors[point * 3] + 3);
+    }
+  };
+  for (unsigned long i = 0; i + 3 < indices.size(); i += 4) {
+    if (i == 0 || indices[i - 2] != indices[i + 1]) {
+      offsets.push_back((long int)points.size() / 3);
+      add_point(indices[i + 1]);
+    }
+    add_point(indices[i + 2]);
+  }
+  offsets.push_back((long int)points.size() / 3);
+  return add_tubes(points, colors.size() == 3 ? colors : points_colors,
+                   offsets, width);
+}